@@ -0,0 +1,75 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace fsb {
+
+arena::arena(std::size_t block_size)
+  : offset_(0) {
+  add_block(block_size);
+}
+
+arena::~arena() {
+  for (const auto & block : blocks_) {
+    ::operator delete(block.data);
+  }
+}
+
+void * arena::allocate(std::size_t size, std::size_t alignment) {
+  block & last = blocks_.back();
+  const std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(last.data);
+  std::size_t offset = 
+    (begin + offset_ + alignment - 1) / alignment * alignment - begin;
+  
+  if (offset + size > last.size) {
+    add_block(std::max(last.size * 2, size + alignment));
+    const std::uintptr_t data = 
+      reinterpret_cast<std::uintptr_t>(blocks_.back().data);
+    offset = (data + alignment - 1) / alignment * alignment - data;
+  }
+  
+  offset_ = offset + size;
+  return blocks_.back().data + offset;
+}
+
+void arena::reset() {
+  if (blocks_.size() > 1) {
+    const std::size_t size = capacity();
+    for (const auto & block : blocks_) {
+      ::operator delete(block.data);
+    }
+    blocks_.clear();
+    add_block(size);
+  }
+  offset_ = 0;
+}
+
+std::size_t arena::capacity() const {
+  std::size_t size = 0;
+  for (const auto & block : blocks_) {
+    size += block.size;
+  }
+  return size;
+}
+
+void arena::add_block(std::size_t size) {
+  blocks_.reserve(blocks_.size() + 1);
+  blocks_.push_back(block {static_cast<char *>(::operator new(size)), size});
+  offset_ = 0;
+}
+
+}
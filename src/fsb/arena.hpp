@@ -0,0 +1,67 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_ARENA_HPP
+#define FSB_ARENA_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace fsb {
+
+// Monotonic allocator for short-lived memory. 
+//
+// Memory is released all at once with reset, which keeps it for reuse, so that
+// once an arena grows to the size needed by a task, repeating the task does 
+// not allocate.
+class arena {
+  arena(const arena &) = delete;
+  arena & operator=(const arena &) = delete;
+public:
+  explicit arena(std::size_t block_size = 4096);
+  ~arena();
+  
+  // Returns uninitialized memory of given size and alignment, valid until 
+  // reset or destruction of the arena.
+  void * allocate(
+    std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+  
+  // Returns uninitialized array of n objects of trivial type T.
+  template <typename T>
+  T * allocate_array(std::size_t n) {
+    return static_cast<T *>(allocate(n * sizeof(T), alignof(T)));
+  }
+  
+  // Releases all allocated memory. If more than one block was used since last
+  // reset, they are replaced with a single block large enough for all of them.
+  void reset();
+  
+  // Returns total size of owned blocks.
+  std::size_t capacity() const;
+  
+private:
+  struct block {
+    char * data;
+    std::size_t size;
+  };
+  
+  void add_block(std::size_t size);
+  
+private:
+  std::vector<block> blocks_;
+  // Offset of first free byte in the last block.
+  std::size_t offset_;
+};
+
+}
+
+#endif
@@ -0,0 +1,62 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/arena.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+
+using namespace fsb;
+
+namespace {
+
+TEST(arena_test, allocations_are_aligned_and_disjoint) {
+  arena arena(64);
+  char * const a = arena.allocate_array<char>(3);
+  std::uint64_t * const b = arena.allocate_array<std::uint64_t>(2);
+  ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(b) % alignof(std::uint64_t));
+  ASSERT_LE(a + 3, reinterpret_cast<char *>(b));
+  
+  std::memset(a, 0xff, 3);
+  b[0] = 0;
+  b[1] = 0;
+  ASSERT_EQ(char(0xff), a[2]);
+}
+
+TEST(arena_test, grows_beyond_block_size) {
+  arena arena(16);
+  char * const a = arena.allocate_array<char>(10);
+  char * const b = arena.allocate_array<char>(100);
+  std::memset(a, 1, 10);
+  std::memset(b, 2, 100);
+  ASSERT_EQ(1, a[9]);
+  ASSERT_LE(16u + 100u, arena.capacity());
+}
+
+TEST(arena_test, reset_coalesces_blocks) {
+  arena arena(16);
+  arena.allocate(10);
+  arena.allocate(100);
+  const std::size_t capacity = arena.capacity();
+  arena.reset();
+  ASSERT_EQ(capacity, arena.capacity());
+  
+  // Same allocations fit into the single block now.
+  char * const a = arena.allocate_array<char>(10);
+  char * const b = arena.allocate_array<char>(100);
+  ASSERT_EQ(capacity, arena.capacity());
+  ASSERT_LT(a, b);
+}
+
+}
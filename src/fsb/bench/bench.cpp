@@ -0,0 +1,255 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/arena.hpp"
+#include "fsb/bench/synthetic.hpp"
+#include "fsb/container.hpp"
+#include "fsb/io/filter.hpp"
+#include "fsb/vorbis/rebuilder.hpp"
+
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/null.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef boost::iostreams::stream<boost::iostreams::array_source> array_istream;
+typedef boost::iostreams::stream<boost::iostreams::null_sink> null_ostream;
+
+struct bench_options {
+  fsb::bench::synthetic_options container;
+  // Minimum duration of a single measurement.
+  std::chrono::milliseconds min_time {200};
+  // Number of measurements, the fastest one is reported.
+  int repetitions = 5;
+};
+
+void usage(const char *name) {
+  std::cout <<
+    "Usage: " << name << " [OPTION]...\n"
+    "Measures throughput of extraction stages on synthetic FSB5 containers.\n"
+    "Each stage is measured without and with encryption.\n"
+    "\n"
+    "Options:\n"
+    "  -h --help         display this help and exit\n"
+    "  -n --samples      number of samples in a container, 64 by default\n"
+    "  -s --sample-size  size of each sample in bytes, 65536 by default\n"
+    "     --packet-size  average size of audio packets, 256 by default\n"
+    "  -p --password     password used for encrypted containers\n"
+    "  -t --min-time     minimum duration of a measurement in milliseconds,\n"
+    "                    200 by default\n"
+    "  -r --repetitions  number of measurements of each stage, fastest one is\n"
+    "                    reported, 5 by default\n";
+}
+
+bench_options parse_options(int argc, char **argv) {
+  bench_options options;
+  options.container.password = "synthetic-password";
+
+  for (int argi=1; argi < argc; ++argi) {
+    const char *arg = argv[argi];
+    if (std::strcmp("--help", arg) == 0 || std::strcmp("-h", arg) == 0) {
+      usage(argv[0]);
+      exit(EXIT_SUCCESS);
+    } else if (std::strcmp("--samples", arg) == 0 || std::strcmp("-n", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.container.samples = std::max(1, std::atoi(argv[++argi]));
+    } else if (std::strcmp("--sample-size", arg) == 0 || std::strcmp("-s", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.container.sample_size = std::max(1, std::atoi(argv[++argi]));
+    } else if (std::strcmp("--packet-size", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.container.packet_size = std::max(1, std::atoi(argv[++argi]));
+    } else if (std::strcmp("--password", arg) == 0 || std::strcmp("-p", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.container.password = argv[++argi];
+      CHECK(!options.container.password.empty()) << "Empty password.";
+    } else if (std::strcmp("--min-time", arg) == 0 || std::strcmp("-t", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.min_time = std::chrono::milliseconds(std::atoi(argv[++argi]));
+    } else if (std::strcmp("--repetitions", arg) == 0 || std::strcmp("-r", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.repetitions = std::max(1, std::atoi(argv[++argi]));
+    } else {
+      std::cerr << "Unrecognized flag: " << arg << std::endl;
+      usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  return options;
+}
+
+// Returns duration of a single call of a function in seconds. Function is 
+// called repeatedly until minimum time elapses, and the fastest of 
+// repetitions is taken, which is least affected by other load on the system.
+template <typename Function>
+double measure(const bench_options & options, Function function) {
+  typedef std::chrono::steady_clock clock;
+  double best = 0;
+  for (int repetition = 0; repetition < options.repetitions; ++repetition) {
+    std::uint64_t iterations = 0;
+    const clock::time_point start = clock::now();
+    clock::duration elapsed;
+    do {
+      function();
+      iterations += 1;
+      elapsed = clock::now() - start;
+    } while (elapsed < options.min_time);
+    const double seconds = 
+      std::chrono::duration<double>(elapsed).count() / iterations;
+    if (repetition == 0 || seconds < best) {
+      best = seconds;
+    }
+  }
+  return best;
+}
+
+// Prints throughput of a stage that processes given number of bytes and 
+// samples in a given time. Stages that are not related to sample size report
+// only time per sample.
+void report(
+  const std::string & stage, 
+  double seconds,
+  std::uint64_t bytes,
+  std::uint64_t samples) {
+  std::cout << std::left << std::setw(24) << stage << std::right;
+  if (bytes) {
+    std::cout << std::setw(12) << std::fixed << std::setprecision(1) 
+      << bytes / seconds / 1e6;
+  } else {
+    std::cout << std::setw(12) << '-';
+  }
+  std::cout << std::setw(14) << std::fixed << std::setprecision(1) 
+    << seconds / samples * 1e9 << std::endl;
+}
+
+// Reads whole stream and discards its content.
+void drain(std::istream & stream) {
+  char buffer[64 * 1024];
+  while (stream.read(buffer, sizeof(buffer)) || stream.gcount()) {
+  }
+}
+
+// Measures stages of extraction using given container.
+void run(const bench_options & options, const std::string & password) {
+  fsb::bench::synthetic_options container_options = options.container;
+  container_options.password = password;
+  const std::vector<char> buffer = 
+    fsb::bench::make_synthetic_container(container_options);
+  
+  array_istream stream(buffer.data(), buffer.size());
+  fsb::container container(stream, password);
+  const std::vector<fsb::sample> & samples = container.samples();
+  const std::uint64_t sample_count = samples.size();
+  const std::uint64_t data_size = container.file_header().data_size;
+  
+  std::cout 
+    << (password.empty() ? "Unencrypted" : "Encrypted") << " container, "
+    << buffer.size() << " bytes, " << sample_count << " samples\n"
+    << std::left << std::setw(24) << "stage" << std::right
+    << std::setw(12) << "MB/s" << std::setw(14) << "ns/sample\n";
+  
+  // Container headers and sample names, without the data section.
+  report("parse headers", measure(options, [&] {
+    array_istream stream(buffer.data(), buffer.size());
+    fsb::container container(stream, password, false);
+  }), container.data_offset(), sample_count);
+  
+  if (!password.empty()) {
+    report("decrypt", measure(options, [&] {
+      boost::iostreams::filtering_istream stream;
+      stream.push(fsb::io::xor_filter(password));
+      stream.push(fsb::io::reverse_bits_filter());
+      stream.push(boost::iostreams::array_source(buffer.data(), buffer.size()));
+      drain(stream);
+    }), buffer.size(), sample_count);
+  }
+  
+  // Lookup of setup header by CRC-32, together with building of
+  // identification and comment headers, as done for each rebuilt sample.
+  fsb::arena arena(512);
+  report("rebuild headers", measure(options, [&] {
+    ogg_packet id, comment, setup;
+    for (const auto & sample : samples) {
+      fsb::vorbis::rebuilder::rebuild_headers(
+        sample.channels, sample.frequency, sample.vorbis_crc32,
+        sample.loop_start, sample.loop_end,
+        arena, id, comment, setup);
+      arena.reset();
+    }
+  }), 0, sample_count);
+  
+  fsb::vorbis::rebuilder rebuilder;
+  report("rebuild", measure(options, [&] {
+    null_ostream output {boost::iostreams::null_sink()};
+    for (const auto & sample : samples) {
+      rebuilder.rebuild(
+        sample, container.sample_view(sample), output);
+    }
+  }), data_size, sample_count);
+  
+  // Audio packets of all samples, muxed without rebuilding headers.
+  std::vector<std::vector<ogg_packet>> packets(samples.size());
+  for (std::size_t i = 0; i < samples.size(); ++i) {
+    fsb::io::buffer_view view = container.sample_view(samples[i]);
+    std::uint16_t packet_size = view.read<std::uint16_t>();
+    while (packet_size) {
+      ogg_packet packet {};
+      packet.packet = reinterpret_cast<unsigned char*>(
+        const_cast<char*>(view.read(packet_size)));
+      packet.bytes = packet_size;
+      packet.packetno = packets[i].size() + 3;
+      packet.granulepos = packets[i].size() * 1024;
+      packets[i].push_back(packet);
+      packet_size = view.offset() + 2 < view.size() ?
+        view.read<std::uint16_t>() : 0;
+    }
+    packets[i].back().e_o_s = 1;
+  }
+  fsb::vorbis::ogg_ostream ogg_stream;
+  report("ogg page output", measure(options, [&] {
+    null_ostream output {boost::iostreams::null_sink()};
+    for (auto & sample_packets : packets) {
+      ogg_stream.reset(1, output);
+      for (auto & packet : sample_packets) {
+        ogg_stream.write_packet(packet);
+      }
+      ogg_stream.flush_packets();
+    }
+  }), data_size, sample_count);
+  
+  std::cout << std::endl;
+}
+
+}
+
+int main(int argc, char **argv) {
+  google::InitGoogleLogging(argv[0]);
+
+  const bench_options options = parse_options(argc, argv);
+  run(options, "");
+  run(options, options.container.password);
+  
+  return EXIT_SUCCESS;
+}
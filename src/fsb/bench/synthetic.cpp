@@ -0,0 +1,174 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/bench/synthetic.hpp"
+
+#include "fsb/error.hpp"
+#include "fsb/fsb.hpp"
+#include "fsb/io/filter.hpp"
+#include "fsb/vorbis/headers_generator.hpp"
+
+#include <algorithm>
+
+namespace fsb { namespace bench {
+
+namespace {
+
+void append_uint8(std::vector<char> & buffer, std::uint8_t x) {
+  buffer.push_back(static_cast<char>(x));
+}
+
+void append_uint32(std::vector<char> & buffer, std::uint32_t x) {
+  for (int i = 0; i < 4; ++i) {
+    buffer.push_back(static_cast<char>(x >> (8 * i)));
+  }
+}
+
+void pad(std::vector<char> & buffer, std::size_t alignment) {
+  buffer.resize((buffer.size() + alignment - 1) / alignment * alignment);
+}
+
+// Returns frequency code used in sample header, or zero if frequency must
+// be stored in an extra header.
+std::uint32_t frequency_code(int rate) {
+  switch (rate) {
+    case  8000: return 1;
+    case 11000: return 2;
+    case 11025: return 3;
+    case 16000: return 4;
+    case 22050: return 5;
+    case 24000: return 6;
+    case 32000: return 7;
+    case 44100: return 8;
+    case 48000: return 9;
+    default:    return 0;
+  }
+}
+
+// Returns ceil(log2(channels)) for channel counts that fit in sample header.
+int channels_code(int channels) {
+  switch (channels) {
+    case 1: return 0;
+    case 2: return 1;
+    case 4: return 2;
+    case 8: return 3;
+    default: return -1;
+  }
+}
+
+// Deterministic pseudo-random numbers, so that containers are reproducible.
+class random {
+public:
+  std::uint32_t operator()() {
+    state_ = state_ * 1103515245u + 12345u;
+    return state_ >> 8u;
+  }
+private:
+  std::uint32_t state_ = 1;
+};
+
+// Appends audio packets of a single sample to data section.
+void append_sample_data(
+  std::vector<char> & data,
+  const synthetic_options & options,
+  random & random) {
+  
+  const std::size_t begin = data.size();
+  for (std::uint32_t packetno = 0; data.size() - begin < options.sample_size;
+       ++packetno) {
+    const std::size_t packet_size = std::min<std::size_t>(0xffff,
+      std::max<std::size_t>(1, options.packet_size / 2 + 
+        random() % (options.packet_size + 1)));
+    data.push_back(static_cast<char>(packet_size));
+    data.push_back(static_cast<char>(packet_size >> 8u));
+    // Packet type 0 (audio), mode 0 uses short blocks and mode 1 long ones.
+    append_uint8(data, packetno % 8 == 0 ? 0x00 : 0x02);
+    for (std::size_t i = 1; i < packet_size; ++i) {
+      append_uint8(data, static_cast<std::uint8_t>(random()));
+    }
+  }
+  // Samples are aligned, padding is read as zero size packet.
+  pad(data, 32);
+}
+
+}
+
+std::vector<char> make_synthetic_container(const synthetic_options & options) {
+  const int channels = channels_code(options.channels);
+  if (channels < 0) {
+    throw error("Unsupported number of channels.");
+  }
+  // Rates without a code are stored in an extra header, the code is then 
+  // overridden.
+  const std::uint32_t frequency = frequency_code(options.rate);
+  
+  const vorbis::headers_generator generator(
+    options.channels, options.rate, options.quality);
+  const std::uint32_t crc32 = vorbis::crc32(generator.setup_header());
+  
+  random random;
+  std::vector<char> headers;
+  std::vector<char> names;
+  std::vector<char> data;
+  
+  for (std::uint32_t i = 0; i < options.samples; ++i) {
+    // Bits: has more flags, frequency, log2(channels), sample offset / 32.
+    const std::uint32_t offset = data.size() / 32;
+    append_uint32(headers,
+      1u | (frequency ? frequency : 8u) << 1u | channels << 5u | offset << 7u);
+    append_uint32(headers, 0);
+    if (!frequency) {
+      append_uint32(headers, 1u | 4u << 1u | 0x04u << 24u);
+      append_uint32(headers, options.rate);
+    }
+    // Vorbis header without seek table.
+    append_uint32(headers, 4u << 1u | 0x16u << 24u);
+    append_uint32(headers, crc32);
+    
+    append_sample_data(data, options, random);
+  }
+  
+  // Table of name offsets, followed by names.
+  std::string names_data;
+  for (std::uint32_t i = 0; i < options.samples; ++i) {
+    append_uint32(names, options.samples * 4u + names_data.size());
+    names_data += options.name_prefix + std::to_string(i);
+    names_data.push_back(0);
+  }
+  names.insert(names.end(), names_data.begin(), names_data.end());
+  pad(names, 32);
+  
+  std::vector<char> container {'F', 'S', 'B', '5'};
+  append_uint32(container, 1);
+  append_uint32(container, options.samples);
+  append_uint32(container, headers.size());
+  append_uint32(container, names.size());
+  append_uint32(container, data.size());
+  append_uint32(container, static_cast<std::uint32_t>(format::vorbis));
+  container.resize(container.size() + 8 + 24);
+  container.insert(container.end(), headers.begin(), headers.end());
+  container.insert(container.end(), names.begin(), names.end());
+  container.insert(container.end(), data.begin(), data.end());
+  
+  if (!options.password.empty()) {
+    // Inverse of decryption, which reverses bits and then applies the key.
+    const std::string & key = options.password;
+    for (std::size_t i = 0; i < container.size(); ++i) {
+      container[i] = static_cast<char>(io::reverse_bits(
+        static_cast<std::uint8_t>(container[i] ^ key[i % key.size()])));
+    }
+  }
+  
+  return container;
+}
+
+}}
@@ -0,0 +1,49 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_BENCH_SYNTHETIC_HPP
+#define FSB_BENCH_SYNTHETIC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fsb { namespace bench {
+
+// Parameters of a synthetic container.
+struct synthetic_options {
+  // Number of samples in the container.
+  std::uint32_t samples = 64;
+  // Approximate size of audio data of each sample.
+  std::size_t sample_size = 64 * 1024;
+  // Average size of an audio packet.
+  std::size_t packet_size = 256;
+  int channels = 2;
+  int rate = 44100;
+  // Vorbis encoder quality in range [1, 100].
+  int quality = 50;
+  // Container is encrypted if password is not empty.
+  std::string password;
+  // Samples are named by the prefix followed by sample index.
+  std::string name_prefix = "sample_";
+};
+
+// Generates a FSB5 container with Vorbis samples.
+//
+// Headers are valid, and audio packets have correct sizes and modes, so that
+// samples can be rebuilt, but packets are not decodable.
+std::vector<char> make_synthetic_container(const synthetic_options & options);
+
+}}
+
+#endif
@@ -0,0 +1,68 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/bench/synthetic.hpp"
+#include "fsb/container.hpp"
+
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+using namespace fsb;
+
+namespace {
+
+typedef boost::iostreams::stream<boost::iostreams::array_source> array_istream;
+
+TEST(synthetic_test, container_is_readable) {
+  bench::synthetic_options options;
+  options.samples = 3;
+  options.sample_size = 1000;
+  options.rate = 44100;
+  const std::vector<char> buffer = bench::make_synthetic_container(options);
+  
+  array_istream stream(buffer.data(), buffer.size());
+  container container(stream, "");
+  ASSERT_EQ(format::vorbis, container.file_header().mode);
+  ASSERT_EQ(3u, container.samples().size());
+  
+  for (const auto & sample : container.samples()) {
+    ASSERT_EQ(2u, sample.channels);
+    ASSERT_EQ(44100u, sample.frequency);
+    ASSERT_LE(1000u, sample.size);
+    ASSERT_LT(0u, container.sample_duration(sample));
+    
+    std::ostringstream output;
+    container.extract_sample(sample, output);
+    ASSERT_EQ("OggS", output.str().substr(0, 4));
+  }
+  ASSERT_EQ("sample_2", container.samples()[2].name);
+}
+
+TEST(synthetic_test, encrypted_container) {
+  bench::synthetic_options options;
+  options.samples = 2;
+  options.sample_size = 500;
+  options.rate = 12345;
+  options.password = "key";
+  const std::vector<char> buffer = bench::make_synthetic_container(options);
+  
+  array_istream stream(buffer.data(), buffer.size());
+  container container(stream, options.password);
+  ASSERT_EQ(2u, container.samples().size());
+  ASSERT_EQ(12345u, container.samples()[0].frequency);
+  ASSERT_EQ("sample_1", container.samples()[1].name);
+}
+
+}
@@ -0,0 +1,206 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/capi/fsb.h"
+
+#include "fsb/container.hpp"
+#include "fsb/error.hpp"
+
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/stream.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <string>
+
+namespace {
+
+std::atomic<std::uint64_t> next_serial {1};
+
+}
+
+struct fsb_container {
+  std::unique_ptr<fsb::container> container;
+  // Identifies the handle in extraction kept by a thread.
+  std::uint64_t serial = next_serial++;
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+fsb_status fail(fsb_status status, const std::string & message) {
+  last_error = message;
+  return status;
+}
+
+// Runs function converting exceptions to status codes, so that they never 
+// cross the C interface.
+template <typename Function>
+fsb_status guarded(Function function) {
+  try {
+    return function();
+  } catch (const fsb::error & e) {
+    return fail(FSB_ERROR_FORMAT, e.what());
+  } catch (const std::bad_alloc &) {
+    return fail(FSB_ERROR_OUT_OF_MEMORY, "Out of memory.");
+  } catch (const std::exception & e) {
+    return fail(FSB_ERROR_IO, e.what());
+  } catch (...) {
+    return fail(FSB_ERROR_IO, "Unknown error.");
+  }
+}
+
+// Output of the last extraction in the calling thread. It is kept when it 
+// does not fit into caller's buffer, so that a follow-up call with larger 
+// buffer only copies it. Handles are told apart by their serial numbers, 
+// which unlike addresses are never reused.
+struct extraction {
+  std::uint64_t serial = 0;
+  std::size_t index = 0;
+  std::string output;
+};
+
+thread_local extraction last_extraction;
+
+fsb_status open(
+  std::istream & stream, const char * password, fsb_container ** container) {
+  std::unique_ptr<fsb_container> handle(new fsb_container());
+  handle->container.reset(
+    new fsb::container(stream, password ? password : ""));
+  *container = handle.release();
+  return FSB_OK;
+}
+
+// Returns sample with given index, or null if index is out of range.
+const fsb::sample * find_sample(
+  const fsb_container * container, std::size_t index) {
+  if (!container || index >= container->container->samples().size()) {
+    return nullptr;
+  }
+  return &container->container->samples()[index];
+}
+
+}
+
+int fsb_api_version(void) {
+  return FSB_API_VERSION;
+}
+
+const char * fsb_last_error(void) {
+  return last_error.c_str();
+}
+
+fsb_status fsb_container_open_path(
+  const char * path, const char * password, fsb_container ** container) {
+  if (!path || !container) {
+    return fail(FSB_ERROR_INVALID_ARGUMENT, "Null argument.");
+  }
+  return guarded([&] {
+    std::ifstream stream(path, std::ios_base::in | std::ios_base::binary);
+    if (!stream) {
+      return fail(FSB_ERROR_IO, std::string("Failed to open path: ") + path);
+    }
+    return open(stream, password, container);
+  });
+}
+
+fsb_status fsb_container_open_memory(
+  const void * data, size_t size, const char * password,
+  fsb_container ** container) {
+  if ((!data && size) || !container) {
+    return fail(FSB_ERROR_INVALID_ARGUMENT, "Null argument.");
+  }
+  return guarded([&] {
+    boost::iostreams::stream<boost::iostreams::array_source> stream(
+      static_cast<const char *>(data), size);
+    return open(stream, password, container);
+  });
+}
+
+void fsb_container_close(fsb_container * container) {
+  delete container;
+}
+
+uint32_t fsb_container_format(const fsb_container * container) {
+  return container ? 
+    static_cast<std::uint32_t>(container->container->file_header().mode) : 0;
+}
+
+size_t fsb_container_sample_count(const fsb_container * container) {
+  return container ? container->container->samples().size() : 0;
+}
+
+fsb_status fsb_container_sample_info(
+  const fsb_container * container, size_t index, fsb_sample_info * info) {
+  const fsb::sample * const sample = find_sample(container, index);
+  if (!sample || !info) {
+    return fail(FSB_ERROR_INVALID_ARGUMENT, "Invalid sample.");
+  }
+  // Names are null terminated within names table of the container.
+  info->name = sample->name.data();
+  info->frequency = sample->frequency;
+  info->channels = sample->channels;
+  info->offset = sample->offset;
+  info->size = sample->size;
+  info->vorbis_crc32 = sample->vorbis_crc32;
+  info->loop_start = sample->loop_start;
+  info->loop_end = sample->loop_end;
+  return FSB_OK;
+}
+
+fsb_status fsb_container_sample_duration(
+  fsb_container * container, size_t index, uint64_t * duration) {
+  const fsb::sample * const sample = find_sample(container, index);
+  if (!sample || !duration) {
+    return fail(FSB_ERROR_INVALID_ARGUMENT, "Invalid sample.");
+  }
+  return guarded([&] {
+    *duration = container->container->sample_duration(*sample);
+    return FSB_OK;
+  });
+}
+
+fsb_status fsb_container_extract_sample(
+  fsb_container * container, size_t index,
+  void * buffer, size_t capacity, size_t * size) {
+  const fsb::sample * const sample = find_sample(container, index);
+  if (!sample || (!buffer && capacity) || !size) {
+    return fail(FSB_ERROR_INVALID_ARGUMENT, "Invalid sample.");
+  }
+  return guarded([&] {
+    extraction & last = last_extraction;
+    if (last.serial != container->serial || last.index != index) {
+      last.serial = 0;
+      last.output.clear();
+      boost::iostreams::stream<
+        boost::iostreams::back_insert_device<std::string>> output(last.output);
+      // Rebuilds with rebuilder owned by the calling thread.
+      container->container->extract_sample(*sample, output);
+      output.flush();
+      last.serial = container->serial;
+      last.index = index;
+    }
+    *size = last.output.size();
+    if (*size > capacity) {
+      return fail(FSB_ERROR_BUFFER_TOO_SMALL, "Buffer is too small.");
+    }
+    std::memcpy(buffer, last.output.data(), *size);
+    last.serial = 0;
+    return FSB_OK;
+  });
+}
@@ -0,0 +1,118 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_CAPI_FSB_H
+#define FSB_CAPI_FSB_H
+
+/* C interface of the fsb library, for use through shared library fsb_c.
+ *
+ * Container handles are safe to use from multiple threads at once, except for
+ * fsb_container_close, which must not run concurrently with other calls using
+ * the same handle. Error messages are kept per thread. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  define FSB_API __declspec(dllexport)
+#elif defined(__GNUC__)
+#  define FSB_API __attribute__((visibility("default")))
+#else
+#  define FSB_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Version of the interface, incremented on incompatible changes. */
+#define FSB_API_VERSION 1
+
+typedef enum fsb_status {
+  FSB_OK = 0,
+  /* Invalid argument, e.g. null pointer or sample index out of range. */
+  FSB_ERROR_INVALID_ARGUMENT = 1,
+  /* Malformed or unsupported container or sample. */
+  FSB_ERROR_FORMAT = 2,
+  /* File could not be read. */
+  FSB_ERROR_IO = 3,
+  /* Output does not fit into the buffer, required size is returned. */
+  FSB_ERROR_BUFFER_TOO_SMALL = 4,
+  FSB_ERROR_OUT_OF_MEMORY = 5
+} fsb_status;
+
+typedef struct fsb_container fsb_container;
+
+/* Metadata of a sample. */
+typedef struct fsb_sample_info {
+  /* Name, valid until container is closed. */
+  const char * name;
+  uint32_t frequency;
+  uint32_t channels;
+  /* Position and size of sample in the data section. */
+  uint64_t offset;
+  uint64_t size;
+  uint32_t vorbis_crc32;
+  uint32_t loop_start;
+  uint32_t loop_end;
+} fsb_sample_info;
+
+/* Returns FSB_API_VERSION of the library. */
+FSB_API int fsb_api_version(void);
+
+/* Returns message describing last error in the calling thread. */
+FSB_API const char * fsb_last_error(void);
+
+/* Opens container file. Password may be null or empty for containers that
+ * are not encrypted. */
+FSB_API fsb_status fsb_container_open_path(
+  const char * path, const char * password, fsb_container ** container);
+
+/* Opens container from memory. Data is copied, so buffer can be released
+ * once the call returns. */
+FSB_API fsb_status fsb_container_open_memory(
+  const void * data, size_t size, const char * password,
+  fsb_container ** container);
+
+/* Closes container. Does nothing for null handle. */
+FSB_API void fsb_container_close(fsb_container * container);
+
+/* Returns sample format, one of the FSB5 format codes (e.g. 15 for Vorbis). */
+FSB_API uint32_t fsb_container_format(const fsb_container * container);
+
+/* Returns number of samples in container. */
+FSB_API size_t fsb_container_sample_count(const fsb_container * container);
+
+/* Retrieves metadata of a sample with given index. */
+FSB_API fsb_status fsb_container_sample_info(
+  const fsb_container * container, size_t index, fsb_sample_info * info);
+
+/* Computes duration of a Vorbis sample as number of PCM samples per channel.*/
+FSB_API fsb_status fsb_container_sample_duration(
+  fsb_container * container, size_t index, uint64_t * duration);
+
+/* Extracts sample into a buffer, as an Ogg file for Vorbis samples or as a
+ * WAV file for PCM samples. Size of the output is stored in size. 
+ *
+ * If output is larger than capacity, FSB_ERROR_BUFFER_TOO_SMALL is returned
+ * and size is set to the required capacity. Buffer may be null if capacity 
+ * is zero, to query the size. Output that did not fit is kept by the calling
+ * thread, so that the next call for the same sample only copies it. */
+FSB_API fsb_status fsb_container_extract_sample(
+  fsb_container * container, size_t index,
+  void * buffer, size_t capacity, size_t * size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,191 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/capi/fsb.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Test links only the shared library, without a second copy of the library 
+// state from the static one. Container and output expected from it are 
+// written beforehand by fsb_capi_test_data.
+#ifndef FSB_CAPI_TEST_DATA
+#error FSB_CAPI_TEST_DATA must name the test data prefix.
+#endif
+
+namespace {
+
+std::string read_file(const std::string & path) {
+  std::ifstream stream(path, std::ios_base::in | std::ios_base::binary);
+  EXPECT_TRUE(stream) << "Failed to open: " << path;
+  return std::string(
+    std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
+
+std::vector<char> make_container() {
+  const std::string data = read_file(FSB_CAPI_TEST_DATA ".fsb");
+  return std::vector<char>(data.begin(), data.end());
+}
+
+struct expected_sample {
+  std::uint64_t duration;
+  std::string output;
+};
+
+std::vector<expected_sample> read_expected() {
+  std::ifstream stream(
+    FSB_CAPI_TEST_DATA ".expected", std::ios_base::in | std::ios_base::binary);
+  EXPECT_TRUE(stream);
+  std::vector<expected_sample> samples;
+  expected_sample sample;
+  std::size_t size;
+  while (stream >> sample.duration >> size && stream.get() == '\n') {
+    sample.output.resize(size);
+    stream.read(&sample.output[0], size);
+    samples.push_back(sample);
+  }
+  return samples;
+}
+
+std::string extract(fsb_container * container, std::size_t index) {
+  std::size_t size = 0;
+  EXPECT_EQ(FSB_ERROR_BUFFER_TOO_SMALL, 
+    fsb_container_extract_sample(container, index, nullptr, 0, &size));
+  std::string output(size, '\0');
+  EXPECT_EQ(FSB_OK, fsb_container_extract_sample(
+    container, index, &output[0], output.size(), &size));
+  EXPECT_EQ(output.size(), size);
+  return output;
+}
+
+TEST(capi_test, extracts_expected_output) {
+  const std::vector<char> buffer = make_container();
+  const std::vector<expected_sample> expected = read_expected();
+  ASSERT_EQ(4u, expected.size());
+  
+  fsb_container * container = nullptr;
+  ASSERT_EQ(FSB_OK, fsb_container_open_memory(
+    buffer.data(), buffer.size(), "secret", &container));
+  ASSERT_EQ(15u, fsb_container_format(container));
+  ASSERT_EQ(4u, fsb_container_sample_count(container));
+  
+  for (std::size_t i = 0; i != 4; ++i) {
+    fsb_sample_info info;
+    ASSERT_EQ(FSB_OK, fsb_container_sample_info(container, i, &info));
+    ASSERT_NE(std::string(), info.name);
+    ASSERT_EQ(2u, info.channels);
+    ASSERT_EQ(44100u, info.frequency);
+    
+    std::uint64_t duration = 0;
+    ASSERT_EQ(FSB_OK, fsb_container_sample_duration(container, i, &duration));
+    ASSERT_EQ(expected[i].duration, duration);
+    
+    ASSERT_EQ(expected[i].output, extract(container, i));
+  }
+  
+  fsb_container_close(container);
+}
+
+TEST(capi_test, extracts_into_large_enough_buffer) {
+  const std::vector<char> buffer = make_container();
+  const std::vector<expected_sample> expected = read_expected();
+  fsb_container * container = nullptr;
+  ASSERT_EQ(FSB_OK, fsb_container_open_memory(
+    buffer.data(), buffer.size(), "secret", &container));
+  
+  // Query for one sample followed by extraction of another.
+  std::size_t size = 0;
+  ASSERT_EQ(FSB_ERROR_BUFFER_TOO_SMALL,
+    fsb_container_extract_sample(container, 0, nullptr, 0, &size));
+  ASSERT_EQ(expected[0].output.size(), size);
+  
+  std::string output(expected[1].output.size() + 100, '\0');
+  ASSERT_EQ(FSB_OK, fsb_container_extract_sample(
+    container, 1, &output[0], output.size(), &size));
+  ASSERT_EQ(expected[1].output, output.substr(0, size));
+  
+  // Same sample from another handle.
+  fsb_container * other = nullptr;
+  ASSERT_EQ(FSB_OK, fsb_container_open_memory(
+    buffer.data(), buffer.size(), "secret", &other));
+  ASSERT_EQ(FSB_ERROR_BUFFER_TOO_SMALL,
+    fsb_container_extract_sample(container, 2, nullptr, 0, &size));
+  ASSERT_EQ(expected[2].output, extract(other, 2));
+  
+  fsb_container_close(other);
+  fsb_container_close(container);
+}
+
+TEST(capi_test, reports_errors) {
+  fsb_sample_info info;
+  fsb_container * container = nullptr;
+  const char garbage[] = "not a container";
+  ASSERT_EQ(FSB_ERROR_FORMAT, fsb_container_open_memory(
+    garbage, sizeof(garbage), nullptr, &container));
+  ASSERT_EQ(nullptr, container);
+  ASSERT_NE(std::string(), fsb_last_error());
+  
+  ASSERT_EQ(FSB_ERROR_IO, fsb_container_open_path(
+    "/nonexistent/container.fsb", nullptr, &container));
+  ASSERT_EQ(FSB_ERROR_INVALID_ARGUMENT, 
+    fsb_container_open_path(nullptr, nullptr, &container));
+  
+  const std::vector<char> buffer = make_container();
+  ASSERT_EQ(FSB_OK, fsb_container_open_memory(
+    buffer.data(), buffer.size(), "secret", &container));
+  ASSERT_EQ(FSB_ERROR_INVALID_ARGUMENT, 
+    fsb_container_sample_info(container, 4, &info));
+  
+  std::size_t size = 0;
+  char small[16];
+  ASSERT_EQ(FSB_ERROR_BUFFER_TOO_SMALL, fsb_container_extract_sample(
+    container, 0, small, sizeof(small), &size));
+  ASSERT_LT(sizeof(small), size);
+  fsb_container_close(container);
+}
+
+TEST(capi_test, concurrent_extraction) {
+  const std::vector<char> buffer = make_container();
+  fsb_container * container = nullptr;
+  ASSERT_EQ(FSB_OK, fsb_container_open_memory(
+    buffer.data(), buffer.size(), "secret", &container));
+  
+  std::vector<std::string> expected;
+  for (std::size_t i = 0; i != 4; ++i) {
+    expected.push_back(extract(container, i));
+  }
+  
+  std::vector<std::string> outputs(4);
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i != 4; ++i) {
+    threads.emplace_back([&, i] {
+      for (int repetition = 0; repetition != 10; ++repetition) {
+        outputs[i] = extract(container, (i + repetition) % 4);
+      }
+    });
+  }
+  for (auto & thread : threads) {
+    thread.join();
+  }
+  for (std::size_t i = 0; i != 4; ++i) {
+    ASSERT_EQ(expected[(i + 9) % 4], outputs[i]);
+  }
+  fsb_container_close(container);
+}
+
+}
@@ -0,0 +1,69 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/bench/synthetic.hpp"
+#include "fsb/container.hpp"
+
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+// Writes container used by C interface test, and output expected from it.
+// C interface test links only the shared library, so the expected output is
+// made beforehand by this program.
+//
+// Expected output has a line with duration and size of each sample, followed 
+// by the extracted sample itself.
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " CONTAINER EXPECTED\n";
+    return EXIT_FAILURE;
+  }
+
+  fsb::bench::synthetic_options options;
+  options.samples = 4;
+  options.sample_size = 2000;
+  options.password = "secret";
+  const std::vector<char> buffer = 
+    fsb::bench::make_synthetic_container(options);
+
+  std::ofstream container_file(argv[1], std::ios_base::binary);
+  container_file.write(buffer.data(), buffer.size());
+  if (!container_file.flush()) {
+    std::cerr << "Failed to write: " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  boost::iostreams::stream<boost::iostreams::array_source> stream(
+    buffer.data(), buffer.size());
+  fsb::container container(stream, options.password);
+  std::ofstream expected_file(argv[2], std::ios_base::binary);
+  for (const fsb::sample & sample : container.samples()) {
+    std::ostringstream output;
+    container.extract_sample(sample, output);
+    expected_file 
+      << container.sample_duration(sample) << ' ' 
+      << output.str().size() << '\n'
+      << output.str();
+  }
+  if (!expected_file.flush()) {
+    std::cerr << "Failed to write: " << argv[2] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/chain.hpp"
+
+#include "fsb/error.hpp"
+#include "fsb/trace.hpp"
+
+#include <istream>
+#include <ostream>
+#include <sstream>
+
+namespace fsb {
+
+namespace {
+const char magic[] = "fsb-chain-index";
+const int version = 1;
+}
+
+chain_writer::chain_writer(const std::string & path)
+  : path_(path)
+  , output_(path, std::ios_base::out | std::ios_base::binary)
+  , offset_(0) {
+  if (!output_) {
+    throw error("Failed to open output file: " + path);
+  }
+}
+
+void chain_writer::append(
+  std::uint32_t serial, const std::string & name, const std::string & data) {
+  output_.write(data.data(), data.size());
+  if (!output_) {
+    throw error("Failed to write output file: " + path_);
+  }
+  entries_.push_back(entry {serial, offset_, data.size(), name});
+  offset_ += data.size();
+}
+
+void chain_writer::finish(const std::string & index_path) {
+  {
+    trace::scoped_span span("close output", path_);
+    output_.close();
+    if (!output_) {
+      throw error("Failed to write output file: " + path_);
+    }
+  }
+  
+  std::ofstream index(index_path);
+  write_index(index, entries_);
+  if (!index.flush()) {
+    throw error("Failed to write index: " + index_path);
+  }
+}
+
+void chain_writer::write_index(
+  std::ostream & stream, const std::vector<entry> & entries) {
+  stream << magic << ' ' << version << '\n';
+  for (const auto & entry : entries) {
+    stream 
+      << entry.serial << ' ' << entry.offset << ' ' << entry.size << ' ' 
+      << entry.name << '\n';
+  }
+}
+
+std::vector<chain_writer::entry> chain_writer::read_index(
+  std::istream & stream) {
+  std::string line;
+  if (!std::getline(stream, line) || 
+      line != std::string(magic) + ' ' + std::to_string(version)) {
+    throw error("Unsupported chain index format: " + line);
+  }
+  
+  std::vector<entry> entries;
+  while (std::getline(stream, line)) {
+    std::istringstream line_stream(line);
+    entry entry;
+    line_stream >> entry.serial >> entry.offset >> entry.size;
+    if (!line_stream || line_stream.get() != ' ') {
+      throw error("Malformed chain index line: " + line);
+    }
+    std::getline(line_stream, entry.name);
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
+
+}
@@ -0,0 +1,74 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_CHAIN_HPP
+#define FSB_CHAIN_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace fsb {
+
+// Writes samples one after another into a single chained Ogg file, each as a
+// logical bitstream with its own serial number, and keeps an index of their
+// byte ranges.
+//
+// Index format is a line with "fsb-chain-index 1", followed by a line per 
+// sample with serial number, offset, size and name separated by spaces. Name
+// extends until the end of line.
+class chain_writer {
+  chain_writer(const chain_writer &) = delete;
+  chain_writer & operator=(const chain_writer &) = delete;
+public:
+  // Location of a sample within chained file.
+  struct entry {
+    std::uint32_t serial;
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::string name;
+  };
+  
+  // Creates or truncates chained file.
+  explicit chain_writer(const std::string & path);
+  
+  // Appends Ogg stream of a sample.
+  void append(
+    std::uint32_t serial, const std::string & name, const std::string & data);
+  
+  // Returns index of appended samples.
+  const std::vector<entry> & entries() const {
+    return entries_;
+  }
+  
+  // Flushes chained file and writes index to a given path.
+  void finish(const std::string & index_path);
+  
+  // Writes index.
+  static void write_index(
+    std::ostream & stream, const std::vector<entry> & entries);
+  
+  // Reads index written by write_index.
+  static std::vector<entry> read_index(std::istream & stream);
+  
+private:
+  std::string path_;
+  std::ofstream output_;
+  std::uint64_t offset_;
+  std::vector<entry> entries_;
+};
+
+}
+
+#endif
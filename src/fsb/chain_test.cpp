@@ -0,0 +1,67 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/chain.hpp"
+#include "fsb/error.hpp"
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+using namespace fsb;
+
+namespace {
+
+TEST(chain_test, samples_are_appended) {
+  const boost::filesystem::path directory = 
+    boost::filesystem::temp_directory_path() / 
+    boost::filesystem::unique_path();
+  boost::filesystem::create_directories(directory);
+  const std::string path = (directory / "chain.ogg").native();
+  const std::string index_path = path + ".index";
+  
+  {
+    chain_writer writer(path);
+    writer.append(1, "first", "OggSaaa");
+    writer.append(2, "second sample", "OggSbb");
+    writer.finish(index_path);
+  }
+  
+  std::ifstream stream(path, std::ios_base::binary);
+  const std::string content {
+    std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+  ASSERT_EQ("OggSaaaOggSbb", content);
+  
+  std::ifstream index_stream(index_path);
+  const std::vector<chain_writer::entry> entries = 
+    chain_writer::read_index(index_stream);
+  ASSERT_EQ(2u, entries.size());
+  ASSERT_EQ(2u, entries[1].serial);
+  ASSERT_EQ(7u, entries[1].offset);
+  ASSERT_EQ(6u, entries[1].size);
+  ASSERT_EQ("second sample", entries[1].name);
+  
+  boost::filesystem::remove_all(directory);
+}
+
+TEST(chain_test, read_malformed_index) {
+  std::istringstream unsupported("fsb-chain-index 2\n");
+  ASSERT_THROW(chain_writer::read_index(unsupported), fsb::error);
+  
+  std::istringstream malformed("fsb-chain-index 1\n1 x 2 name\n");
+  ASSERT_THROW(chain_writer::read_index(malformed), fsb::error);
+}
+
+}
@@ -12,31 +12,253 @@
 //
 #include "fsb/container.hpp"
 
+#include "fsb/error.hpp"
 #include "fsb/fsb.hpp"
 #include "fsb/io/filter.hpp"
 #include "fsb/io/utility.hpp"
+#include "fsb/io/wav.hpp"
+#include "fsb/stats.hpp"
+#include "fsb/trace.hpp"
 #include "fsb/vorbis/rebuilder.hpp"
 
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/range/adaptor/reversed.hpp>
 #include <boost/utility/string_ref.hpp>
-#include <glog/logging.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
 
 namespace fsb {
+
+namespace {
+
+// Throws error with given message if condition is false.
+void check_format(bool condition, const char * message) {
+  if (!condition) {
+    throw error(message);
+  }
+}
+
+// Returns FNV-1a hash of a name.
+std::uint64_t hash_name(boost::string_ref name) {
+  std::uint64_t hash = 14695981039346656037u;
+  for (const char c : name) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211u;
+  }
+  return hash;
+}
+
+}
  
-container::container(std::istream & encoded_stream, boost::string_ref password) {
+container::container(
+  std::istream & encoded_stream,
+  boost::string_ref password,
+  bool read_data)
+  : password_(password) {
   boost::iostreams::filtering_istream stream;
-  if (!password.empty()) {
-    // Decrypt stream if password is provided.
-    stream.push(fsb::io::xor_filter(password));
-    stream.push(fsb::io::reverse_bits_filter());
-  }
+  push_decryption_filters(stream, 0);
   stream.push(encoded_stream);
   
-  read_file_header(stream);
-  read_sample_headers(stream);
-  read_sample_names(stream);
+  {
+    trace::scoped_span span("parse headers");
+    stats::scoped_timer timer(stats::stage::parse);
+    read_file_header(stream);
+    read_sample_headers(stream);
+    read_sample_names(stream);
+  }
+  if (!password_.empty()) {
+    stats::add(stats::counter::bytes_decrypted, data_offset());
+  }
+  if (read_data) {
+    trace::scoped_span span(password_.empty() ? "read data" : "decrypt data");
+    stats::scoped_timer timer(stats::stage::read);
+    data_buffer_ = io::read(stream, header_.data_size);
+    if (!password_.empty()) {
+      stats::add(stats::counter::bytes_decrypted, header_.data_size);
+    }
+  }
+}
+
+sample_table container::read_table(
+  std::istream & encoded_stream, 
+  boost::string_ref password) {
+  const container container(encoded_stream, password, false);
+  return sample_table(container.samples());
+}
+
+void container::read_data(std::istream & encoded_stream, bool decrypt) {
+  encoded_stream.clear();
+  if (!encoded_stream.seekg(data_offset())) {
+    throw error("Failed to seek to data section.");
+  }
+  
+  boost::iostreams::filtering_istream stream;
+  if (decrypt) {
+    push_decryption_filters(stream, data_offset());
+  }
+  stream.push(encoded_stream);
+  trace::scoped_span span(
+    password_.empty() || !decrypt ? "read data" : "decrypt data");
+  stats::scoped_timer timer(stats::stage::read);
+  ranges_.clear();
   data_buffer_ = io::read(stream, header_.data_size);
+  data_encrypted_ = !decrypt && !password_.empty();
+  if (!password_.empty() && decrypt) {
+    stats::add(stats::counter::bytes_decrypted, header_.data_size);
+  }
+}
+
+std::vector<container::data_range> container::plan_ranges(
+  const std::vector<const sample *> & samples,
+  std::size_t & buffer_size) const {
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> extents;
+  for (const sample * sample : samples) {
+    check_format(sample->offset <= header_.data_size &&
+      sample->size <= header_.data_size - sample->offset,
+      "Sample exceeds data section.");
+    extents.emplace_back(sample->offset, sample->offset + sample->size);
+  }
+  std::sort(extents.begin(), extents.end());
+  
+  // Reading through a short gap is cheaper than seeking over it.
+  const std::uint64_t max_gap = 64 * 1024;
+  std::vector<data_range> ranges;
+  buffer_size = 0;
+  for (const auto & extent : extents) {
+    if (!ranges.empty() && 
+        extent.first <= ranges.back().offset + ranges.back().size + max_gap) {
+      data_range & range = ranges.back();
+      const std::uint64_t end = 
+        std::max(range.offset + range.size, extent.second);
+      buffer_size += end - (range.offset + range.size);
+      range.size = end - range.offset;
+    } else {
+      ranges.push_back({extent.first, extent.second - extent.first, 
+        buffer_size});
+      buffer_size += extent.second - extent.first;
+    }
+  }
+  return ranges;
+}
+
+std::uint64_t container::buffered_size(
+  const std::vector<const sample *> & samples) const {
+  std::size_t buffer_size = 0;
+  plan_ranges(samples, buffer_size);
+  return buffer_size;
+}
+
+void container::read_data(
+  std::istream & encoded_stream, 
+  const std::vector<const sample *> & samples,
+  bool decrypt) {
+  std::size_t buffer_size = 0;
+  std::vector<data_range> ranges = plan_ranges(samples, buffer_size);
+  
+  trace::scoped_span span(
+    password_.empty() || !decrypt ? "read data" : "decrypt data");
+  stats::scoped_timer timer(stats::stage::read);
+  std::vector<char> buffer(buffer_size);
+  for (const data_range & range : ranges) {
+    read_range(encoded_stream, range.offset, 
+      buffer.data() + range.buffer_offset, range.size, decrypt);
+  }
+  data_buffer_ = std::move(buffer);
+  ranges_ = std::move(ranges);
+  data_encrypted_ = !decrypt && !password_.empty();
+}
+
+void container::decrypt_data() {
+  if (!data_encrypted_) {
+    return;
+  }
+  trace::scoped_span span("decrypt data");
+  if (ranges_.empty()) {
+    io::decrypt(password_, data_offset(), 
+      data_buffer_.data(), data_buffer_.size());
+  }
+  for (const data_range & range : ranges_) {
+    io::decrypt(password_, data_offset() + range.offset, 
+      data_buffer_.data() + range.buffer_offset, range.size);
+  }
+  stats::add(stats::counter::bytes_decrypted, data_buffer_.size());
+  data_encrypted_ = false;
+}
+
+std::vector<char> container::read_sample_data(
+  std::istream & encoded_stream, const sample & sample) const {
+  check_format(sample.offset <= header_.data_size &&
+    sample.size <= header_.data_size - sample.offset,
+    "Sample exceeds data section.");
+  trace::scoped_span span(password_.empty() ? "read data" : "decrypt data");
+  stats::scoped_timer timer(stats::stage::read);
+  std::vector<char> buffer(sample.size);
+  read_range(
+    encoded_stream, sample.offset, buffer.data(), buffer.size(), true);
+  return buffer;
+}
+
+void container::read_range(
+  std::istream & encoded_stream, 
+  std::uint64_t offset, 
+  char * buffer, 
+  std::size_t size,
+  bool decrypt) const {
+  const std::uint64_t container_offset = data_offset() + offset;
+  encoded_stream.clear();
+  if (!encoded_stream.seekg(container_offset)) {
+    throw error("Failed to seek to sample data.");
+  }
+  boost::iostreams::filtering_istream stream;
+  if (decrypt) {
+    push_decryption_filters(stream, container_offset);
+  }
+  stream.push(encoded_stream);
+  io::read(stream, buffer, size);
+  if (!password_.empty() && decrypt) {
+    stats::add(stats::counter::bytes_decrypted, size);
+  }
+}
+
+bool container::has_data(const sample & sample) const {
+  return find_data(sample.offset, sample.size) != nullptr;
+}
+
+const char * container::find_data(
+  std::uint64_t offset, std::uint64_t size) const {
+  if (data_encrypted_) {
+    return nullptr;
+  }
+  if (ranges_.empty()) {
+    return has_data() && offset <= data_buffer_.size() && 
+      size <= data_buffer_.size() - offset ? 
+      data_buffer_.data() + offset : nullptr;
+  }
+  // Last range starting at or before the offset.
+  auto range = std::upper_bound(ranges_.begin(), ranges_.end(), offset,
+    [](std::uint64_t offset, const data_range & range) {
+      return offset < range.offset;
+    });
+  if (range == ranges_.begin()) {
+    return nullptr;
+  }
+  --range;
+  if (size > range->size || offset - range->offset > range->size - size) {
+    return nullptr;
+  }
+  return data_buffer_.data() + range->buffer_offset + 
+    (offset - range->offset);
+}
+
+void container::push_decryption_filters(
+  boost::iostreams::filtering_istream & stream,
+  std::uint64_t offset) const {
+  if (!password_.empty()) {
+    // Decrypt stream if password is provided.
+    stream.push(fsb::io::xor_filter(password_, offset));
+    stream.push(fsb::io::reverse_bits_filter());
+  }
 }
 
 void container::read_file_header(std::istream & stream) {
@@ -48,11 +270,14 @@ void container::read_file_header(std::istream & stream) {
   header_.id[2] = header_view.read_char();
   header_.id[3] = header_view.read_char();
 
-  CHECK(std::equal(header_.id, header_.id + 4, "FSB5"));
+  check_format(std::equal(header_.id, header_.id + 4, "FSB5"),
+    "Not a FSB5 container.");
 
   header_.version = header_view.read_uint32();
 
-  CHECK(header_.version == 1);
+  if (header_.version != 1) {
+    throw error("Unsupported version: " + std::to_string(header_.version));
+  }
 
   header_.samples  = header_view.read_uint32();
   header_.headers_size = header_view.read_uint32();
@@ -60,8 +285,9 @@ void container::read_file_header(std::istream & stream) {
   header_.data_size = header_view.read_uint32();
   
   const std::uint32_t mode = header_view.read_uint32();
-  CHECK(0 < mode && mode < static_cast<std::uint32_t>(format::max))
-    << "Mode field is out of range: " << mode;
+  if (!(0 < mode && mode < static_cast<std::uint32_t>(format::max))) {
+    throw error("Mode field is out of range: " + std::to_string(mode));
+  }
   header_.mode = static_cast<format>(mode);
   
   header_.unknown = header_view.read_uint64();
@@ -83,7 +309,7 @@ void container::read_sample_headers(std::istream & stream) {
   for (auto & sample : boost::adaptors::reverse(samples_)) {
     const auto next_offset = next_sample ?
       next_sample->offset : header_.data_size;
-    CHECK(sample.offset < next_offset);
+    check_format(sample.offset < next_offset, "Samples are not contiguous.");
     sample.size = next_offset - sample.offset;
     next_sample = &sample;
   }  
@@ -97,7 +323,9 @@ sample container::read_sample_header(io::buffer_view & view) {
   // 1 2 3 4 frequency
   // 5 6     log2(channels)
   // 7       first bit of sample offset
-  const std::uint8_t mode = view.read_uint8();
+  // Fixed part of sample header is checked at once.
+  view.require(8);
+  const std::uint8_t mode = view.read_unchecked<std::uint8_t>();
   bool has_extra_headers = mode & 1u;
   sample.channels = 1u << ((mode & 96u) >> 5u);
 
@@ -111,56 +339,64 @@ sample container::read_sample_header(io::buffer_view & view) {
     case 7u: sample.frequency = 32000u; break;
     case 8u: sample.frequency = 44100u; break;
     case 9u: sample.frequency = 48000u; break;
-    default: CHECK(false); break;
+    default: throw error("Unknown frequency."); break;
   }
   
   const std::size_t sample_offset_bit_0      = mode >> 7u;
-  const std::size_t sample_offset_bit_1_plus = view.read_uint24();
+  const std::size_t sample_offset_bit_1_plus = view.read_uint24_unchecked();
   // Samples have 32 byte alignment.
   sample.offset = (sample_offset_bit_0 | sample_offset_bit_1_plus << 1u) << 5u;
   // ???
-  sample.unknown = view.read_uint32();
+  sample.unknown = view.read_unchecked<std::uint32_t>();
 
   while (has_extra_headers) {
     // Bits:
     // 0        has extra headers
     // 1 ... 23 length
-    const uint32_t extra = view.read_uint24();
+    view.require(4);
+    const uint32_t extra = view.read_uint24_unchecked();
     has_extra_headers = extra & 0x01;
     std::size_t extra_length = extra >> 1u;
-    const uint8_t type = view.read_uint8();
+    const uint8_t type = view.read_unchecked<std::uint8_t>();
 
     switch (type) {
       case 0x02: 
-        CHECK(extra_length == 1);
-        sample.channels = view.read_uint8(); 
+        check_format(extra_length == 1, "Invalid channels header.");
+        sample.channels = view.read<std::uint8_t>();
         break;
       case 0x04: 
-        CHECK(extra_length == 4);
-        sample.frequency = view.read_uint32(); 
+        check_format(extra_length == 4, "Invalid frequency header.");
+        sample.frequency = view.read<std::uint32_t>();
         break;
       case 0x06: 
-        CHECK(extra_length == 8);
-        sample.loop_start = view.read_uint32();
-        sample.loop_end = view.read_uint32();
+        check_format(extra_length == 8, "Invalid loop header.");
+        view.require(8);
+        sample.loop_start = view.read_unchecked<std::uint32_t>();
+        sample.loop_end = view.read_unchecked<std::uint32_t>();
         break;
       case 0x16:
-        CHECK(extra_length >= 4);
-        sample.vorbis_crc32 = view.read_uint32();
+        check_format(extra_length >= 4, "Invalid Vorbis header.");
+        sample.vorbis_crc32 = view.read<std::uint32_t>();
         extra_length -= 4;
         // Maybe position / seek information (granulepos)?
-        CHECK(extra_length % 4 == 0);
+        check_format(extra_length % 4 == 0, "Invalid Vorbis seek table.");
         // Seek information. Two sequences non-decreasing sequences of 32 bit
         // numbers laid out as follows:
         // a_1, b_1, a_2, b_2, ..., a_n-1, b_n-1, a_n
         // Where a_i are offsets within sample audio data (pointing at beginning
         // of packets), and b_i are associated granulepos.
         // But there are granulepos only for some packets, not for all of them.
-        view.skip(extra_length);
+        view.require(extra_length);
+        for (std::size_t i = 1; 4 * i < extra_length; i += 2) {
+          view.skip(4);
+          sample.seek_granulepos = std::max(sample.seek_granulepos, 
+            view.read_unchecked<std::uint32_t>());
+        }
+        view.skip(extra_length % 8);
         break;
       default:
-        CHECK(false) << "Unexpected extra header type: " << type;
-        view.skip(extra_length);
+        throw error(
+          "Unexpected extra header type: " + std::to_string(int(type)));
     }
   }
   
@@ -168,8 +404,9 @@ sample container::read_sample_header(io::buffer_view & view) {
 }
 
 void container::read_sample_names(std::istream & stream) {
-  const std::vector<char> names_buffer = io::read(stream, header_.names_size);
-  io::buffer_view names_view(names_buffer.data(), names_buffer.size());
+  names_ = io::read(stream, header_.names_size);
+  io::buffer_view names_view(names_.data(), names_.size());
+  const char * const names_end = names_.data() + names_.size();
 
   for (std::uint32_t i=0; i < header_.samples; ++i) {
     if (names_view.empty()) {
@@ -177,26 +414,142 @@ void container::read_sample_names(std::istream & stream) {
     } else {
       names_view.set_offset(i * 4u);
       names_view.set_offset(names_view.read_uint32());
-      while (char c = names_view.read_char()) {
-        samples_[i].name.push_back(c);
-      }
+      // Names are null terminated within the table, and are used in place.
+      const char * const begin = names_view.begin() + names_view.offset();
+      const char * const end = std::find(begin, names_end, '\0');
+      check_format(end != names_end, "Sample name is not terminated.");
+      samples_[i].name = boost::string_ref(begin, end - begin);
     }
   }
+  build_name_index();
 }
 
-
-void container::extract_sample(const sample & sample, std::ostream & stream) {
-  CHECK(header_.mode == format::vorbis);
+void container::build_name_index() {
+  // Table is at most half full.
+  std::size_t capacity = 1;
+  while (capacity < 2 * samples_.size()) {
+    capacity *= 2;
+  }
+  const std::size_t mask = capacity - 1;
+  name_index_.assign(capacity, 0);
   
+  for (std::size_t i = 0; i < samples_.size(); ++i) {
+    const boost::string_ref name = samples_[i].name;
+    std::size_t slot = hash_name(name) & mask;
+    while (name_index_[slot] && samples_[name_index_[slot] - 1].name != name) {
+      slot = (slot + 1) & mask;
+    }
+    // Only the first of samples with the same name is indexed.
+    if (!name_index_[slot]) {
+      name_index_[slot] = static_cast<std::uint32_t>(i + 1);
+    }
+  }
+}
+
+const sample * container::find_sample(boost::string_ref name) const {
+  const std::size_t mask = name_index_.size() - 1;
+  std::size_t slot = hash_name(name) & mask;
+  while (const std::uint32_t entry = name_index_[slot]) {
+    if (samples_[entry - 1].name == name) {
+      return &samples_[entry - 1];
+    }
+    slot = (slot + 1) & mask;
+  }
+  return nullptr;
+}
+
+
+io::buffer_view container::sample_view(const sample & sample) const {
   // Construct sample data view to verify that we don't exceed sample boundaries 
   // during extraction process.
-  CHECK(sample.offset <= data_buffer_.size());
-  CHECK(sample.offset + sample.size <= data_buffer_.size());
-  const char * const sample_begin = data_buffer_.data() + sample.offset;
+  check_format(has_data() || !ranges_.empty(), "Sample data was not read.");
+  check_format(sample.offset <= header_.data_size &&
+    sample.size <= header_.data_size - sample.offset,
+    "Sample exceeds data section.");
+  const char * const sample_begin = find_data(sample.offset, sample.size);
+  check_format(sample_begin != nullptr, "Sample data was not read.");
   const char * const sample_end = sample_begin + sample.size;
-  io::buffer_view sample_view(sample_begin, sample_end);
-  vorbis::rebuilder rebuilder;
-  rebuilder.rebuild(sample, sample_view, stream);
+  return io::buffer_view(sample_begin, sample_end);
+}
+
+void container::extract_sample(const sample & sample, std::ostream & stream) {
+  extract_sample(sample, stream, vorbis::thread_rebuilder());
+}
+
+void container::extract_sample(
+  const sample & sample,
+  std::ostream & stream,
+  vorbis::rebuilder & rebuilder) {
+  trace::scoped_span span("extract_sample", sample.name);
+  if (is_pcm()) {
+    const std::uint32_t data_size = write_wav_header(sample, stream);
+    const io::buffer_view view = sample_view(sample);
+    stats::scoped_timer timer(stats::stage::write);
+    stats::add(stats::counter::bytes_written, data_size);
+    if (header_.mode == format::pcm8) {
+      // WAV uses unsigned 8-bit samples.
+      for (std::uint32_t i = 0; i < data_size; ++i) {
+        stream.put(static_cast<char>(view.begin()[i] ^ 0x80));
+      }
+    } else {
+      stream.write(view.begin(), data_size);
+    }
+    if (data_size & 1u) {
+      stream.put(0);
+    }
+    return;
+  }
+  
+  if (header_.mode != format::vorbis) {
+    throw error("Unsupported format: " + std::to_string(int(header_.mode)));
+  }
+  
+  rebuilder.rebuild(sample, sample_view(sample), stream);
 }
 
+bool container::is_pcm() const {
+  switch (header_.mode) {
+    case format::pcm8:
+    case format::pcm16:
+    case format::pcm24:
+    case format::pcm32:
+    case format::pcmfloat:
+      return true;
+    default:
+      return false;
+  }
+}
+
+std::uint32_t container::write_wav_header(
+  const sample & sample, std::ostream & stream) const {
+  io::wav_format format;
+  format.channels = sample.channels;
+  format.rate = sample.frequency;
+  switch (header_.mode) {
+    case format::pcm8:     format.bits_per_sample =  8; break;
+    case format::pcm16:    format.bits_per_sample = 16; break;
+    case format::pcm24:    format.bits_per_sample = 24; break;
+    case format::pcm32:    format.bits_per_sample = 32; break;
+    case format::pcmfloat: 
+      format.format_tag = 3;
+      format.bits_per_sample = 32;
+      break;
+    default: 
+      throw error("Not a PCM format: " + std::to_string(int(header_.mode)));
+  }
+  
+  // Samples are aligned, so there might be some padding after last frame.
+  const std::uint32_t block_align = 
+    format.channels * (format.bits_per_sample / 8u);
+  check_format(block_align != 0, "Sample without channels.");
+  const std::uint32_t data_size = sample.size - sample.size % block_align;
+  io::write_wav_header(
+    stream, format, data_size, sample.loop_start, sample.loop_end);
+  return data_size;
+}
+
+std::uint64_t container::sample_duration(const sample & sample) const {
+  check_format(header_.mode == format::vorbis, "Not a Vorbis container.");
+  return vorbis::thread_rebuilder().duration(sample, sample_view(sample));
+}
 }
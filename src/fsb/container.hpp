@@ -15,20 +15,39 @@
 
 #include "fsb/fsb.hpp"
 #include "fsb/io/buffer_view.hpp"
+#include "fsb/sample_table.hpp"
 
+#include <boost/iostreams/filtering_stream.hpp>
 #include <boost/utility/string_ref.hpp>
 
+#include <cstdint>
 #include <iosfwd>
+#include <string>
 #include <vector>
 
 namespace fsb {
 
+namespace vorbis {
+class rebuilder;
+}
+
 class container {
   container(const container &) = delete;
   container & operator=(const container &) = delete;
   
 public:
-  container(std::istream & encoded_stream, boost::string_ref password);
+  // Reads container from a stream. If read_data is false, only headers and
+  // names are read, and sample data can be read later with read_data.
+  container(
+    std::istream & encoded_stream, 
+    boost::string_ref password,
+    bool read_data = true);
+  
+  // Reads only headers and names of a container from a stream, and returns
+  // them as a compact table. Use it to keep metadata of many containers.
+  static sample_table read_table(
+    std::istream & encoded_stream, 
+    boost::string_ref password);
   
   const header & file_header() const {
     return header_;
@@ -38,10 +57,85 @@ public:
     return samples_;
   }
   
-  // Extracts sample audio data to given stream.
+  // Returns the first sample with a given name, or null if there is none.
+  const sample * find_sample(boost::string_ref name) const;
+  
+  // Returns offset of data section from the beginning of a container.
+  std::uint64_t data_offset() const {
+    return header_size + header_.headers_size + header_.names_size;
+  }
+  
+  // Returns true if data section was read and decrypted.
+  bool has_data() const {
+    return ranges_.empty() && data_buffer_.size() == header_.data_size &&
+      !data_encrypted_;
+  }
+  
+  // Returns true if data of a given sample was read.
+  bool has_data(const sample & sample) const;
+  
+  // Reads data section from the same stream that container was constructed
+  // from. Stream must be seekable. If decrypt is false, data stays encrypted
+  // and is not available until decrypt_data is called.
+  void read_data(std::istream & encoded_stream, bool decrypt = true);
+  
+  // Reads data of given samples only, from the same stream that container 
+  // was constructed from. Stream must be seekable. Data of remaining samples
+  // is not available afterwards. Decrypt is as above.
+  void read_data(
+    std::istream & encoded_stream, 
+    const std::vector<const sample *> & samples,
+    bool decrypt = true);
+  
+  // Returns number of bytes read_data buffers for given samples.
+  std::uint64_t buffered_size(
+    const std::vector<const sample *> & samples) const;
+  
+  // Decrypts data that was read without decryption. Does nothing if there 
+  // is none.
+  void decrypt_data();
+  
+  // Reads data of a single sample from the same stream that container was
+  // constructed from, and returns it without keeping it in the container.
+  // Stream must be seekable.
+  std::vector<char> read_sample_data(
+    std::istream & encoded_stream, const sample & sample) const;
+  
+  // Returns true if samples are stored as PCM.
+  bool is_pcm() const;
+  
+  // Writes WAV headers for a PCM sample. Returns number of bytes of sample
+  // data, that should follow the headers.
+  std::uint32_t write_wav_header(
+    const sample & sample, std::ostream & stream) const;
+  
+  // Extracts sample audio data to given stream, using rebuilder owned by the
+  // calling thread.
   void extract_sample(const sample & sample, std::ostream & stream);
   
+  // Extracts sample audio data to given stream. Vorbis samples are rebuilt 
+  // with given rebuilder, which should be reused for subsequent samples.
+  void extract_sample(
+    const sample & sample, 
+    std::ostream & stream,
+    vorbis::rebuilder & rebuilder);
+  
+  // Returns sample duration as a number of PCM samples per channel.
+  // 
+  // Scans only the chain of packet sizes, without rebuilding the sample. 
+  // Block sizes tables are cached by rebuilder owned by the calling thread.
+  std::uint64_t sample_duration(const sample & sample) const;
+  
+  // Returns view on sample audio data.
+  io::buffer_view sample_view(const sample & sample) const;
+  
 private:
+  // Pushes filters decrypting a stream that starts at given offset within 
+  // the container. Does nothing if container is not encrypted.
+  void push_decryption_filters(
+    boost::iostreams::filtering_istream & stream,
+    std::uint64_t offset) const;
+  
   // Reads file header from a stream.
   void read_file_header(std::istream & stream);
   
@@ -56,11 +150,52 @@ private:
   // Reads sample names.
   void read_sample_names(std::istream & stream);
   
+  // Builds hash index of sample names.
+  void build_name_index();
+  
+  // Reads a range of data section into a buffer, decrypting it if asked to.
+  void read_range(
+    std::istream & encoded_stream, 
+    std::uint64_t offset, 
+    char * buffer, 
+    std::size_t size,
+    bool decrypt) const;
+  
+  // Returns pointer to data of a given range within data section, or null if 
+  // it was not read.
+  const char * find_data(std::uint64_t offset, std::uint64_t size) const;
+  
 private:
+  // Part of data section read into memory.
+  struct data_range {
+    // Offset from start of data section.
+    std::uint64_t offset;
+    std::uint64_t size;
+    // Offset within data buffer.
+    std::size_t buffer_offset;
+  };
+  
+  // Returns ranges of data section covering given samples, and total size
+  // of the ranges.
+  std::vector<data_range> plan_ranges(
+    const std::vector<const sample *> & samples,
+    std::size_t & buffer_size) const;
+  
   static const int header_size = 60;
+  std::string password_;
   header header_;
   std::vector<sample> samples_;
+  // Names table, sample names are views on it.
+  std::vector<char> names_;
+  // Open addressing hash table of sample names, with linear probing. Contains
+  // sample index increased by one, or zero in empty slots.
+  std::vector<std::uint32_t> name_index_;
   std::vector<char> data_buffer_;
+  // Ranges of data buffer ordered by offset, empty if whole data section
+  // was read.
+  std::vector<data_range> ranges_;
+  // Data buffer was read without decryption.
+  bool data_encrypted_ = false;
 };
 
 }
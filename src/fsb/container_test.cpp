@@ -0,0 +1,147 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/bench/synthetic.hpp"
+#include "fsb/container.hpp"
+#include "fsb/error.hpp"
+
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <gtest/gtest.h>
+
+#include <string>
+
+using namespace fsb;
+
+namespace {
+
+typedef boost::iostreams::stream<boost::iostreams::array_source> array_istream;
+
+std::string view_string(const io::buffer_view & view) {
+  return std::string(view.begin(), view.size());
+}
+
+TEST(container_test, read_data_of_selected_samples) {
+  bench::synthetic_options options;
+  options.samples = 5;
+  // Large enough for gaps between samples to be skipped.
+  options.sample_size = 100 * 1024;
+  options.password = "key";
+  const std::vector<char> buffer = bench::make_synthetic_container(options);
+  
+  array_istream full_stream(buffer.data(), buffer.size());
+  const container full(full_stream, options.password);
+  
+  array_istream stream(buffer.data(), buffer.size());
+  container partial(stream, options.password, false);
+  const auto & samples = partial.samples();
+  partial.read_data(stream, {&samples[3], &samples[0], &samples[1]});
+  ASSERT_FALSE(partial.has_data());
+  
+  for (std::size_t i = 0; i < samples.size(); ++i) {
+    const bool selected = i != 2 && i != 4;
+    ASSERT_EQ(selected, partial.has_data(samples[i]));
+    if (selected) {
+      ASSERT_EQ(
+        view_string(full.sample_view(full.samples()[i])), 
+        view_string(partial.sample_view(samples[i])));
+    } else {
+      ASSERT_THROW(partial.sample_view(samples[i]), fsb::error);
+    }
+  }
+  
+  // Reading whole data section afterwards makes all samples available.
+  partial.read_data(stream);
+  ASSERT_TRUE(partial.has_data());
+  ASSERT_EQ(
+    view_string(full.sample_view(full.samples()[4])),
+    view_string(partial.sample_view(samples[4])));
+}
+
+TEST(container_test, decrypt_data_after_reading) {
+  bench::synthetic_options options;
+  options.samples = 5;
+  options.sample_size = 100 * 1024;
+  options.password = "key";
+  const std::vector<char> buffer = bench::make_synthetic_container(options);
+  
+  array_istream full_stream(buffer.data(), buffer.size());
+  const container full(full_stream, options.password);
+  
+  array_istream stream(buffer.data(), buffer.size());
+  container whole(stream, options.password, false);
+  whole.read_data(stream, false);
+  ASSERT_FALSE(whole.has_data());
+  whole.decrypt_data();
+  ASSERT_TRUE(whole.has_data());
+  
+  array_istream partial_stream(buffer.data(), buffer.size());
+  container partial(partial_stream, options.password, false);
+  const auto & samples = partial.samples();
+  const std::vector<const sample *> selected {&samples[1], &samples[4]};
+  partial.read_data(partial_stream, selected, false);
+  ASSERT_THROW(partial.sample_view(samples[1]), fsb::error);
+  partial.decrypt_data();
+  ASSERT_LE(samples[1].size + samples[4].size, partial.buffered_size(selected));
+  
+  for (std::size_t i = 0; i < samples.size(); ++i) {
+    ASSERT_EQ(
+      view_string(full.sample_view(full.samples()[i])), 
+      view_string(whole.sample_view(whole.samples()[i])));
+  }
+  for (const sample * sample : selected) {
+    const std::size_t i = sample - samples.data();
+    ASSERT_EQ(
+      view_string(full.sample_view(full.samples()[i])), 
+      view_string(partial.sample_view(*sample)));
+  }
+}
+
+TEST(container_test, read_table) {
+  bench::synthetic_options options;
+  options.samples = 10;
+  options.sample_size = 100;
+  options.password = "key";
+  const std::vector<char> buffer = bench::make_synthetic_container(options);
+  
+  array_istream stream(buffer.data(), buffer.size());
+  const container container(stream, options.password, false);
+  array_istream table_stream(buffer.data(), buffer.size());
+  const sample_table table = 
+    container::read_table(table_stream, options.password);
+  
+  ASSERT_EQ(container.samples().size(), table.size());
+  for (std::size_t i = 0; i < table.size(); ++i) {
+    const sample & sample = container.samples()[i];
+    ASSERT_EQ(sample.name, table.name(i));
+    ASSERT_EQ(sample.offset, table.offset(i));
+    ASSERT_EQ(sample.size, table.sample_size(i));
+    ASSERT_EQ(sample.vorbis_crc32, table.vorbis_crc32(i));
+  }
+}
+
+TEST(container_test, find_sample) {
+  bench::synthetic_options options;
+  options.samples = 100;
+  options.sample_size = 100;
+  const std::vector<char> buffer = bench::make_synthetic_container(options);
+  
+  array_istream stream(buffer.data(), buffer.size());
+  const container container(stream, "", false);
+  for (const auto & sample : container.samples()) {
+    ASSERT_EQ(&sample, container.find_sample(sample.name));
+  }
+  ASSERT_EQ(nullptr, container.find_sample("sample_100"));
+  ASSERT_EQ(nullptr, container.find_sample(""));
+}
+
+}
@@ -0,0 +1,146 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/content_store.hpp"
+
+#include "fsb/error.hpp"
+
+#include <boost/crc.hpp>
+#include <boost/filesystem.hpp>
+#include <glog/logging.h>
+
+#include <cstdio>
+#include <fstream>
+
+namespace fsb {
+
+namespace {
+
+// Bumped whenever rebuilder output changes, to invalidate existing objects.
+const std::uint32_t rebuild_version = 1;
+
+// Returns extension of files extracted from containers of a given format.
+const char * extension(format mode) {
+  switch (mode) {
+    case format::pcm8:
+    case format::pcm16:
+    case format::pcm24:
+    case format::pcm32:
+    case format::pcmfloat:
+      return ".wav";
+    default:
+      return ".ogg";
+  }
+}
+
+// 64-bit FNV-1a hash.
+class fnv1a_64 {
+public:
+  void process_bytes(const void * buffer, std::size_t size) {
+    const unsigned char * bytes = static_cast<const unsigned char *>(buffer);
+    for (std::size_t i = 0; i < size; ++i) {
+      hash_ = (hash_ ^ bytes[i]) * 0x100000001b3ull;
+    }
+  }
+  
+  void process_uint32(std::uint32_t x) {
+    const unsigned char bytes[] {
+      static_cast<unsigned char>(x),
+      static_cast<unsigned char>(x >> 8u),
+      static_cast<unsigned char>(x >> 16u),
+      static_cast<unsigned char>(x >> 24u)};
+    process_bytes(bytes, sizeof(bytes));
+  }
+  
+  std::uint64_t checksum() const {
+    return hash_;
+  }
+  
+private:
+  std::uint64_t hash_ = 0xcbf29ce484222325ull;
+};
+
+}
+
+content_store::content_store(boost::filesystem::path root)
+  : root_(std::move(root)) {
+  boost::filesystem::create_directories(root_);
+}
+
+std::string content_store::key(
+  format mode, const sample & sample, io::buffer_view sample_view) {
+  
+  fnv1a_64 fnv;
+  fnv.process_uint32(rebuild_version);
+  fnv.process_uint32(static_cast<std::uint32_t>(mode));
+  fnv.process_uint32(sample.channels);
+  fnv.process_uint32(sample.frequency);
+  fnv.process_uint32(sample.vorbis_crc32);
+  fnv.process_uint32(sample.loop_start);
+  fnv.process_uint32(sample.loop_end);
+  fnv.process_bytes(sample_view.begin(), sample_view.size());
+  
+  // CRC-32 of data and its size make key collisions very unlikely, even
+  // without a cryptographic hash.
+  boost::crc_32_type crc;
+  crc.process_bytes(sample_view.begin(), sample_view.size());
+  
+  char key[48];
+  std::snprintf(key, sizeof(key), "%016llx%08x-%llx%s",
+    static_cast<unsigned long long>(fnv.checksum()),
+    static_cast<unsigned>(crc.checksum()),
+    static_cast<unsigned long long>(sample_view.size()),
+    extension(mode));
+  return key;
+}
+
+boost::filesystem::path content_store::object_path(
+  const std::string & key) const {
+  CHECK(key.size() > 2) << "Invalid key: " << key;
+  // Objects are spread over 256 subdirectories to keep directories small.
+  return root_ / key.substr(0, 2) / key;
+}
+
+bool content_store::contains(const std::string & key) const {
+  return boost::filesystem::exists(object_path(key));
+}
+
+void content_store::insert(
+  const std::string & key,
+  const std::function<void(std::ostream &)> & writer) {
+  
+  const boost::filesystem::path path = object_path(key);
+  boost::filesystem::create_directories(path.parent_path());
+  
+  const boost::filesystem::path temporary = path.parent_path() / 
+    boost::filesystem::unique_path("%%%%-%%%%-%%%%-%%%%.tmp");
+  {
+    std::ofstream output(temporary.native(), 
+      std::ios_base::out | std::ios_base::binary);
+    if (!output) {
+      throw error("Failed to open output file: " + temporary.native());
+    }
+    try {
+      writer(output);
+      if (!output.flush()) {
+        throw error("Failed to write output file: " + temporary.native());
+      }
+    } catch (...) {
+      output.close();
+      boost::filesystem::remove(temporary);
+      throw;
+    }
+  }
+  boost::filesystem::rename(temporary, path);
+}
+
+}
@@ -0,0 +1,62 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_CONTENT_STORE_HPP
+#define FSB_CONTENT_STORE_HPP
+
+#include "fsb/fsb.hpp"
+#include "fsb/io/buffer_view.hpp"
+
+#include <boost/filesystem/path.hpp>
+
+#include <functional>
+#include <iosfwd>
+#include <string>
+
+namespace fsb {
+
+// Directory with rebuilt samples stored under names derived from their content.
+//
+// Identical samples found in different containers are rebuilt and stored only 
+// once. Objects are written to a temporary file first and then renamed, so the
+// store never contains partially written objects.
+class content_store {
+public:
+  // Constructs store in a given directory. Directory is created if necessary.
+  explicit content_store(boost::filesystem::path root);
+  
+  // Returns key identifying rebuilt sample. 
+  //
+  // Key is derived from container format, sample data and all sample 
+  // parameters used during rebuild. It ends with extension of the rebuilt
+  // file, ".wav" for PCM formats and ".ogg" otherwise.
+  static std::string key(
+    format mode, const sample & sample, io::buffer_view sample_view);
+  
+  // Returns path of an object with given key.
+  boost::filesystem::path object_path(const std::string & key) const;
+  
+  // Returns true if object with given key is already in the store.
+  bool contains(const std::string & key) const;
+  
+  // Stores object with given key, with content produced by a writer.
+  void insert(
+    const std::string & key,
+    const std::function<void(std::ostream &)> & writer);
+  
+private:
+  boost::filesystem::path root_;
+};
+
+}
+
+#endif
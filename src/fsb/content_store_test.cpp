@@ -0,0 +1,91 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/content_store.hpp"
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+
+#include <ostream>
+
+using namespace fsb;
+
+namespace {
+
+TEST(content_store_test, key_depends_on_data_and_parameters) {
+  const char data[] { 1, 2, 3, 4 };
+  const char other_data[] { 1, 2, 3, 5 };
+  const io::buffer_view view(data, 4);
+  
+  sample sample;
+  sample.channels = 2;
+  sample.frequency = 44100;
+  sample.vorbis_crc32 = 123;
+  
+  const std::string key = content_store::key(format::vorbis, sample, view);
+  ASSERT_EQ(key, content_store::key(format::vorbis, sample, view));
+  ASSERT_NE(key, content_store::key(
+    format::vorbis, sample, io::buffer_view(other_data, 4)));
+  
+  // Sample name and offset do not matter.
+  fsb::sample renamed = sample;
+  renamed.name = "other";
+  renamed.offset = 1024;
+  ASSERT_EQ(key, content_store::key(format::vorbis, renamed, view));
+  
+  fsb::sample looped = sample;
+  looped.loop_start = 10;
+  looped.loop_end = 20;
+  ASSERT_NE(key, content_store::key(format::vorbis, looped, view));
+}
+
+TEST(content_store_test, key_depends_on_format) {
+  const char data[] { 1, 2, 3, 4 };
+  const io::buffer_view view(data, 4);
+  
+  sample sample;
+  sample.channels = 1;
+  sample.frequency = 44100;
+  
+  const std::string vorbis = content_store::key(format::vorbis, sample, view);
+  const std::string pcm8 = content_store::key(format::pcm8, sample, view);
+  const std::string pcm16 = content_store::key(format::pcm16, sample, view);
+  ASSERT_NE(vorbis, pcm8);
+  ASSERT_NE(vorbis, pcm16);
+  ASSERT_NE(pcm8, pcm16);
+  
+  // Objects have the same extension as extracted files.
+  content_store store(boost::filesystem::temp_directory_path());
+  ASSERT_EQ(".ogg", store.object_path(vorbis).extension());
+  ASSERT_EQ(".wav", store.object_path(pcm8).extension());
+  ASSERT_EQ(".wav", store.object_path(pcm16).extension());
+}
+
+TEST(content_store_test, insert) {
+  const boost::filesystem::path root =
+    boost::filesystem::temp_directory_path() /
+    boost::filesystem::unique_path("fsb-store-%%%%-%%%%");
+  
+  {
+    content_store store(root);
+    const std::string key = "0123456789abcdef-4.ogg";
+    ASSERT_FALSE(store.contains(key));
+    
+    store.insert(key, [](std::ostream & output) { output << "data"; });
+    ASSERT_TRUE(store.contains(key));
+    ASSERT_EQ(4u, boost::filesystem::file_size(store.object_path(key)));
+  }
+  
+  boost::filesystem::remove_all(root);
+}
+
+}
@@ -0,0 +1,35 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_ERROR_HPP
+#define FSB_ERROR_HPP
+
+#include <stdexcept>
+#include <string>
+
+namespace fsb {
+
+// Recoverable error caused by malformed or unsupported input, or by failed 
+// input / output operation. 
+//
+// Unlike failed CHECKs, which indicate bugs in the program itself, errors
+// affect only processing of a single container or sample.
+class error : public std::runtime_error {
+public:
+  explicit error(const std::string & what)
+    : std::runtime_error(what) {
+  }
+};
+
+}
+
+#endif
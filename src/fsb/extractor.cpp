@@ -10,42 +10,167 @@
 // MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
 // GNU General Public License for more details.
 //
+#include "fsb/chain.hpp"
 #include "fsb/container.hpp"
+#include "fsb/content_store.hpp"
+#include "fsb/error.hpp"
+#include "fsb/job_list.hpp"
+#include "fsb/key_recovery.hpp"
+#include "fsb/manifest.hpp"
+#include "fsb/raw.hpp"
+#include "fsb/sample_filter.hpp"
+#include "fsb/server.hpp"
+#include "fsb/spsc_queue.hpp"
+#include "fsb/stats.hpp"
+#include "fsb/trace.hpp"
+#include "fsb/io/file.hpp"
+#include "fsb/io/wav.hpp"
+#include "fsb/vorbis/decoder.hpp"
+#include "fsb/vorbis/rebuilder.hpp"
 
 #include <boost/filesystem.hpp>
 #include <glog/logging.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
 #include <cstdlib>
 #include <cstring>
+#include <exception>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+#include <unistd.h>
 
 namespace {
 
 struct extractor_options {
   bool extract;
+  bool recover_password;
+  // Single selected sample is written to standard output.
+  bool to_stdout;
+  bool wav;
+  bool raw;
+  unsigned jobs;
   std::string password;
   boost::filesystem::path destination;
-  std::vector<boost::filesystem::path> paths;
+  boost::filesystem::path state;
+  boost::filesystem::path store;
+  boost::filesystem::path store_manifest;
+  boost::filesystem::path quarantine;
+  // Format of statistics printed at exit, empty if disabled.
+  std::string stats;
+  boost::filesystem::path stats_prometheus;
+  boost::filesystem::path trace;
+  boost::filesystem::path chain;
+  boost::filesystem::path serve;
+  std::size_t cache;
+  // Limit of connections served at once.
+  std::size_t max_connections;
+  // Limit of container bytes read ahead of extraction.
+  std::uint64_t max_buffered;
+  fsb::vorbis::verification verify;
+  // Samples to extract from each container.
+  fsb::sample_filter filter;
+  std::vector<fsb::job_entry> containers;
 };
 
 void usage(const char *name) {
   std::cout <<
-    "Usage: " << name << " [OPTION]... [FSB_FILE]...\n"
-    "Extracts or lists content of Vorbis files from FSB5 container.\n"
+    "Usage: " << name << " [OPTION]... [FSB_FILE | @JOB_LIST]...\n"
+    "Extracts or lists content of Vorbis and PCM files from FSB5 container.\n"
+    "\n"
+    "Job list contains a line per container with tab separated path of\n"
+    "container, and optionally destination directory and names of samples\n"
+    "to extract. Job list is read from standard input if it is -. Its\n"
+    "containers are processed in order of their placement on disk.\n"
     "\n"
     "Options:\n"
     "  -h --help         display this help and exit\n"
     "  -p --password     password used to encode FSB files\n"
+    "     --recover-password\n"
+    "                    find password of encrypted containers from their\n"
+    "                    headers, and print it next to container path\n"
     "  -d --destination  directory where extracted files will be placed,\n"
     "                    current working directory is used by default\n"
-    "  -l  --list        only list content of container without extracting\n";
+    "  -l  --list        only list content of container without extracting\n"
+    "     --stdout       write the only selected sample to standard output,\n"
+    "                    instead of listing content of container\n"
+    "  -w  --wav         decode samples and write them as WAV files\n"
+    "  -r  --raw         write sample data as stored in container, together\n"
+    "                    with a text file describing the sample\n"
+    "  -j  --jobs        number of samples processed in parallel,\n"
+    "                    number of available processors is used by default\n"
+    "  -s  --state       file with state of previous runs, containers and\n"
+    "                    samples that did not change since then, and whose\n"
+    "                    outputs still exist, are skipped\n"
+    "     --store        directory where each unique sample is stored once,\n"
+    "                    extracted files become hard links to stored samples\n"
+    "     --store-manifest\n"
+    "                    instead of creating hard links, append stored sample\n"
+    "                    and destination name pairs to a given file\n"
+    "  -q  --quarantine  directory where partial output of failed samples is\n"
+    "                    moved, and where all failures are listed\n"
+    "     --stats[=FORMAT]\n"
+    "                    print time spent in each stage and event counters\n"
+    "                    at exit, FORMAT is either table (default) or json\n"
+    "     --stats-prometheus\n"
+    "                    write statistics to a given file in Prometheus\n"
+    "                    text format\n"
+    "     --chain        write all Vorbis samples into a single chained Ogg\n"
+    "                    file, with index of samples next to it\n"
+    "     --trace        write timeline of extraction to a given file in\n"
+    "                    Chrome trace event format\n"
+    "     --serve        serve extraction requests on a given Unix socket\n"
+    "                    until interrupted\n"
+    "     --cache        number of containers kept open when serving,\n"
+    "                    64 by default\n"
+    "     --max-connections\n"
+    "                    number of connections served at once, 64 by\n"
+    "                    default\n"
+    "     --max-buffered limit in MiB of containers read ahead, while\n"
+    "                    samples of previous ones are extracted, 512 by\n"
+    "                    default\n"
+    "     --verify[=MODE]\n"
+    "                    check rebuilt Vorbis samples, MODE is either fast\n"
+    "                    (default), which checks packet chain, granule\n"
+    "                    positions and loop points, or full, which also\n"
+    "                    decodes every audio packet\n"
+    "     --sample       extract sample with a given zero-based index within\n"
+    "                    its container\n"
+    "     --name-glob    extract samples with names matching a given\n"
+    "                    wildcard pattern\n"
+    "     --name-regex   extract samples with names containing a match of\n"
+    "                    a given regular expression\n"
+    "\n"
+    "Sample selection options can be repeated, and a sample is extracted if\n"
+    "it matches any of them. Only data of selected samples is read.\n";
 }
 
 extractor_options parse_options(int argc, char **argv) {
   extractor_options options;
   options.destination = boost::filesystem::current_path();
   options.extract = true;
+  options.recover_password = false;
+  options.to_stdout = false;
+  options.wav = false;
+  options.raw = false;
+  options.jobs = std::max(1u, std::thread::hardware_concurrency());
+  options.cache = 64;
+  options.max_connections = 64;
+  options.max_buffered = 512u << 20;
+  options.verify = fsb::vorbis::verification::none;
 
   for (int argi=1; argi < argc; ++argi) {
     const char *arg = argv[argi];
@@ -55,24 +180,129 @@ extractor_options parse_options(int argc, char **argv) {
     } else if (std::strcmp("--password", arg) == 0 || std::strcmp("-p", arg) == 0) {
       CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
       options.password = argv[++argi];
+    } else if (std::strcmp("--recover-password", arg) == 0) {
+      options.recover_password = true;
     } else if (std::strcmp("--destination", arg) == 0 || std::strcmp("-d", arg) == 0) {
       CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
       options.destination = argv[++argi];
     } else if (std::strcmp("--list", arg) == 0 || std::strcmp("-l", arg) == 0) {
       options.extract = false;
+    } else if (std::strcmp("--stdout", arg) == 0) {
+      options.to_stdout = true;
+    } else if (std::strcmp("--wav", arg) == 0 || std::strcmp("-w", arg) == 0) {
+      options.wav = true;
+    } else if (std::strcmp("--raw", arg) == 0 || std::strcmp("-r", arg) == 0) {
+      options.raw = true;
+    } else if (std::strcmp("--jobs", arg) == 0 || std::strcmp("-j", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.jobs = std::max(1, std::atoi(argv[++argi]));
+    } else if (std::strcmp("--state", arg) == 0 || std::strcmp("-s", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.state = argv[++argi];
+    } else if (std::strcmp("--store", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.store = argv[++argi];
+    } else if (std::strcmp("--store-manifest", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.store_manifest = argv[++argi];
+    } else if (std::strcmp("--quarantine", arg) == 0 || std::strcmp("-q", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.quarantine = argv[++argi];
+    } else if (std::strcmp("--stats", arg) == 0) {
+      options.stats = "table";
+    } else if (std::strncmp("--stats=", arg, 8) == 0) {
+      options.stats = arg + 8;
+      CHECK(options.stats == "table" || options.stats == "json")
+        << "Unknown statistics format: " << options.stats;
+    } else if (std::strcmp("--stats-prometheus", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.stats_prometheus = argv[++argi];
+    } else if (std::strcmp("--chain", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.chain = argv[++argi];
+    } else if (std::strcmp("--trace", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.trace = argv[++argi];
+    } else if (std::strcmp("--serve", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.serve = argv[++argi];
+    } else if (std::strcmp("--cache", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.cache = std::max(1, std::atoi(argv[++argi]));
+    } else if (std::strcmp("--max-connections", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.max_connections = std::max(1, std::atoi(argv[++argi]));
+    } else if (std::strcmp("--max-buffered", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.max_buffered = 
+        std::uint64_t(std::max(1, std::atoi(argv[++argi]))) << 20;
+    } else if (std::strcmp("--verify", arg) == 0 || 
+               std::strcmp("--verify=fast", arg) == 0) {
+      options.verify = fsb::vorbis::verification::fast;
+    } else if (std::strcmp("--verify=full", arg) == 0) {
+      options.verify = fsb::vorbis::verification::full;
+    } else if (std::strcmp("--sample", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      char * end = nullptr;
+      const char * const index = argv[++argi];
+      options.filter.add_index(std::strtoul(index, &end, 10));
+      CHECK(*index && *end == '\0') << "Invalid sample index: " << index;
+    } else if (std::strcmp("--name-glob", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      options.filter.add_glob(argv[++argi]);
+    } else if (std::strcmp("--name-regex", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      try {
+        options.filter.add_regex(argv[++argi]);
+      } catch (const fsb::error & e) {
+        LOG(FATAL) << e.what();
+      }
     } else if (std::strcmp("--", arg) == 0) {
       while (++argi < argc)
-        options.paths.push_back(arg);
+        options.containers.push_back({argv[argi], {}, {}});
       break;
     } else if (arg[0] == '-') {
       std::cerr << "Unrecognized flag: " << arg << std::endl;
       usage(argv[0]);
       exit(EXIT_FAILURE);
+    } else if (arg[0] == '@') {
+      std::vector<fsb::job_entry> entries;
+      if (std::strcmp("@-", arg) == 0) {
+        entries = fsb::read_job_list(std::cin);
+      } else {
+        std::ifstream stream(arg + 1);
+        CHECK(stream) << "Failed to open job list: " << arg + 1;
+        entries = fsb::read_job_list(stream);
+      }
+      fsb::sort_for_sequential_io(entries);
+      std::move(entries.begin(), entries.end(), 
+        std::back_inserter(options.containers));
     } else {
-      options.paths.push_back(arg);
+      options.containers.push_back({arg, {}, {}});
     }
   }
 
+  CHECK(!options.wav || options.store.empty())
+    << "Decoded samples cannot be placed in the store.";
+  CHECK(!options.raw || options.store.empty())
+    << "Raw samples cannot be placed in the store.";
+  CHECK(!options.raw || !options.wav)
+    << "Only one of --raw and --wav can be used.";
+  CHECK(options.chain.empty() || 
+    (!options.raw && !options.wav && options.store.empty() && 
+     options.state.empty()))
+    << "Chained output cannot be combined with --raw, --wav, --store or "
+       "--state.";
+  CHECK(!options.to_stdout || options.containers.size() == 1)
+    << "Exactly one container is required for --stdout.";
+  CHECK(!options.to_stdout || 
+    (options.extract && !options.raw && options.serve.empty() &&
+     options.chain.empty()))
+    << "Standard output cannot be combined with --list, --raw, --serve or "
+       "--chain.";
+  CHECK(options.serve.empty() || options.containers.empty())
+    << "Containers to extract cannot be given together with --serve.";
+
   return options;
 }
 
@@ -87,60 +317,845 @@ void print_header(std::ostream & os, const fsb::header & header) {
     << "Unknown:       " << header.unknown << '\n';
 }
 
-void print_sample(std::ostream & os, const fsb::sample & sample) {
-  os
-    << "Name:          " << sample.name << '\n'
-    << "Frequency:     " << sample.frequency << '\n'
-    << "Channels:      " << int(sample.channels) << '\n'
-    << "Offset:        " << sample.offset << '\n'
-    << "Size:          " << sample.size << '\n'
-    << "Vorbis CRC-32: " << sample.vorbis_crc32 << '\n'
-    << "Loop start:    " << sample.loop_start << '\n'
-    << "Loop end:      " << sample.loop_end << '\n'
-    << "Unknown:       " << sample.unknown << '\n';
+// Reads manifest from a given path, if it exists.
+fsb::manifest read_manifest(const boost::filesystem::path & path) {
+  fsb::manifest manifest;
+  std::ifstream stream(path.native());
+  if (stream) {
+    manifest.read(stream);
+  }
+  return manifest;
 }
 
+// Returns directory where samples of a given container are extracted.
+boost::filesystem::path destination_directory(
+  const extractor_options & options, const fsb::job_entry & job) {
+  return boost::filesystem::absolute(job.destination.empty() ?
+    options.destination : boost::filesystem::path(job.destination));
 }
 
-int main(int argc, char **argv) {
-  google::InitGoogleLogging(argv[0]);
+// Returns true if all outputs recorded in a manifest entry still exist.
+bool outputs_exist(const fsb::manifest::container_entry & entry) {
+  boost::system::error_code ec;
+  for (const auto & sample : entry.samples) {
+    if (sample.output.empty() || 
+        !boost::filesystem::exists(sample.output, ec)) {
+      return false;
+    }
+  }
+  return true;
+}
 
-  const extractor_options options = parse_options(argc, argv);
+// Writes manifest to a given path, replacing it atomically.
+void write_manifest(
+  const boost::filesystem::path & path, const fsb::manifest & manifest) {
+  boost::filesystem::path temporary = path;
+  temporary += ".tmp";
+  {
+    std::ofstream stream(temporary.native());
+    manifest.write(stream);
+    if (!stream.flush()) {
+      throw fsb::error("Failed to write state file: " + temporary.native());
+    }
+  }
+  boost::filesystem::rename(temporary, path);
+}
+
+// Decodes sample and writes it to a WAV file.
+void write_wav(
+  const fsb::container & container,
+  const fsb::sample & sample,
+  std::ostream & output) {
+  std::vector<std::int16_t> pcm;
+  fsb::vorbis::decoder decoder(sample);
+  decoder.decode(container.sample_view(sample), pcm);
+  
+  fsb::io::wav_format format;
+  format.channels = sample.channels;
+  format.rate = sample.frequency;
+  format.bits_per_sample = 16;
+  // Header is written first, it throws if data does not fit in 32 bits.
+  const std::uint64_t data_size = pcm.size() * sizeof(std::int16_t);
+  fsb::io::write_wav_header(
+    output, format, data_size, sample.loop_start, sample.loop_end);
+  output.write(reinterpret_cast<const char *>(pcm.data()), data_size);
+  if (data_size & 1u) {
+    output.put(0);
+  }
+}
+
+// Writes WAV file with PCM sample data copied directly from container file.
+void copy_pcm(
+  const fsb::container & container,
+  const fsb::sample & sample,
+  int source_fd,
+  const boost::filesystem::path & path) {
+  std::ostringstream header_stream;
+  const std::uint32_t data_size = 
+    container.write_wav_header(sample, header_stream);
+  const std::string header = header_stream.str();
+  
+  fsb::io::unique_fd output = fsb::io::open_for_writing(path.native());
+  fsb::io::write(output.get(), header.data(), header.size());
+  fsb::io::copy_range(
+    source_fd, container.data_offset() + sample.offset, 
+    output.get(), data_size);
+  if (data_size & 1u) {
+    fsb::io::write(output.get(), "", 1);
+  }
+  
+  fsb::trace::scoped_span span("close output");
+  output.close();
+}
+
+// Extracts sample to a given path.
+void write_sample(
+  fsb::container & container,
+  const fsb::sample & sample,
+  bool wav,
+  fsb::vorbis::rebuilder & rebuilder,
+  const boost::filesystem::path & path) {
+  std::ofstream output(path.native());
+  if (wav && !container.is_pcm()) {
+    write_wav(container, sample, output);
+  } else {
+    container.extract_sample(sample, output, rebuilder);
+  }
+  
+  fsb::trace::scoped_span span("close output");
+  output.close();
+  if (!output) {
+    throw fsb::error("Failed to write output file: " + path.native());
+  }
+}
+
+// Prints statistics and writes them to Prometheus text file if requested.
+void write_stats(
+  const extractor_options & options, const fsb::stats::snapshot & snapshot) {
+  if (options.stats == "json") {
+    fsb::stats::write_json(std::cerr, snapshot);
+  } else if (!options.stats.empty()) {
+    fsb::stats::write_table(std::cerr, snapshot);
+  }
+  
+  if (!options.stats_prometheus.empty()) {
+    // Replaced atomically, so that collector never reads partial file.
+    boost::filesystem::path temporary = options.stats_prometheus;
+    temporary += ".tmp";
+    {
+      std::ofstream stream(temporary.native());
+      fsb::stats::write_prometheus(stream, snapshot);
+      CHECK(stream.flush()) << "Failed to write statistics: " << temporary;
+    }
+    boost::filesystem::rename(temporary, options.stats_prometheus);
+  }
+}
+
+// Extraction of a single sample, run in parallel with other jobs.
+struct job {
+  // Name used in failure reports.
+  std::string name;
+  // Output file, removed or moved to quarantine if job fails. Empty if job
+  // does not write a file of its own.
+  boost::filesystem::path output;
+  // Runs job using rebuilder owned by the worker thread.
+  std::function<void(fsb::vorbis::rebuilder &)> run;
+};
+
+// Container read by the loading stage, waiting to be extracted.
+struct loaded_container {
+  fsb::job_entry job;
+  fsb::manifest::container_entry entry;
+  // State of container from previous runs, null if there is none.
+  std::unique_ptr<fsb::manifest::container_entry> previous;
+  // Container did not change since the previous run, and is skipped.
+  bool unchanged = false;
+  std::unique_ptr<fsb::container> container;
+  // Samples are copied directly from source file, instead of from memory.
+  bool zero_copy = false;
+  fsb::io::unique_fd source;
+  // Samples to extract, selected by options and job entry.
+  fsb::sample_filter filter;
+  // Bytes accounted against the limit of buffered containers.
+  std::uint64_t reserved = 0;
+  // Failure of the loading or decryption stage, reported when container is
+  // processed.
+  std::exception_ptr error;
+};
+
+// Extracts content of containers, and keeps track of failures.
+class extractor {
+public:
+  explicit extractor(const extractor_options & options);
+  
+  // Lists content of containers and extracts their samples. Failures are 
+  // reported, but do not stop processing of other containers.
+  //
+  // Containers pass through a pipeline of stages connected by bounded 
+  // queues. Headers are parsed and data is read on a loading thread, data is
+  // decrypted on a thread of its own, and samples are rebuilt and written by 
+  // worker threads. Headers are parsed while reading, as they determine what
+  // is read.
+  void run(const std::vector<fsb::job_entry> & containers);
+  
+  // Saves state, reports summary of failures and returns exit status.
+  int finish();
+  
+private:
+  // Loading stage, running on its own thread.
+  void load_all(
+    const std::vector<fsb::job_entry> & containers,
+    fsb::spsc_queue<std::unique_ptr<loaded_container>> & queue);
+  std::unique_ptr<loaded_container> load(const fsb::job_entry & job);
+  
+  // Decryption stage, running on its own thread.
+  void decrypt_all(
+    fsb::spsc_queue<std::unique_ptr<loaded_container>> & input,
+    fsb::spsc_queue<std::unique_ptr<loaded_container>> & output);
+  
+  // Waits until given number of bytes can be buffered within the limit. 
+  void reserve(std::uint64_t size);
+  void release(std::uint64_t size);
+  
+  void process(loaded_container & loaded);
+  void process_container(loaded_container & loaded);
+  
+  // Runs jobs using configured number of threads.
+  void run_jobs(const std::vector<job> & jobs);
+  
+  // Reports failure of a given container or sample.
+  void report_failure(
+    const std::string & what, 
+    const std::string & reason, 
+    const boost::filesystem::path & output = boost::filesystem::path());
+  
+private:
+  const extractor_options & options_;
+  const bool use_state_;
+  // Guards manifest, which is read by the loading stage.
+  std::mutex manifest_mutex_;
+  fsb::manifest manifest_;
+  std::unique_ptr<fsb::content_store> store_;
+  std::unique_ptr<fsb::chain_writer> chain_;
+  std::ofstream store_manifest_;
+  std::ofstream failures_;
+  std::size_t sample_number_ = 0;
+  // Rebuilders of worker threads, reused between containers.
+  std::vector<std::unique_ptr<fsb::vorbis::rebuilder>> rebuilders_;
+  
+  // Guards failure reports, which happen concurrently within jobs.
+  std::mutex report_mutex_;
+  std::size_t containers_ = 0;
+  std::size_t failed_containers_ = 0;
+  std::atomic<std::size_t> samples_ {0};
+  std::size_t failed_samples_ = 0;
+  
+  // Bytes of loaded containers that were not processed yet.
+  std::mutex buffered_mutex_;
+  std::condition_variable buffered_released_;
+  std::uint64_t buffered_ = 0;
+};
+
+extractor::extractor(const extractor_options & options)
+  : options_(options)
+  , use_state_(!options.state.empty()) {
+  
+  if (use_state_) {
+    manifest_ = read_manifest(options.state);
+  }
+  
+  if (!options.store.empty()) {
+    store_.reset(new fsb::content_store(options.store));
+    if (!options.store_manifest.empty()) {
+      store_manifest_.open(
+        options.store_manifest.native(), std::ios_base::app);
+      CHECK(store_manifest_) 
+        << "Failed to open store manifest: " << options.store_manifest;
+    }
+  }
+  
+  if (!options.chain.empty()) {
+    chain_.reset(new fsb::chain_writer(options.chain.native()));
+  }
   
-  std::size_t sample_number = 0;
-  for (const auto & path : options.paths) {
-    std::ifstream stream(path.native(),
-      std::ios_base::in | std::ios_base::binary);
-    CHECK(stream) << "Failed to open path: " << path.native();
-    fsb::container container(stream, options.password);
+  if (!options.quarantine.empty()) {
+    boost::filesystem::create_directories(options.quarantine);
+    failures_.open(
+      (options.quarantine / "failures.txt").native(), std::ios_base::app);
+    CHECK(failures_) << "Failed to open quarantine: " << options.quarantine;
+  }
+}
+
+void extractor::run(const std::vector<fsb::job_entry> & containers) {
+  fsb::spsc_queue<std::unique_ptr<loaded_container>> loaded_queue(2);
+  fsb::spsc_queue<std::unique_ptr<loaded_container>> decrypted_queue(2);
+  std::thread loader([&] { load_all(containers, loaded_queue); });
+  std::thread decryptor([&] { decrypt_all(loaded_queue, decrypted_queue); });
+  while (std::unique_ptr<loaded_container> loaded = decrypted_queue.pop()) {
+    process(*loaded);
+    const std::uint64_t reserved = loaded->reserved;
+    loaded.reset();
+    release(reserved);
+  }
+  decryptor.join();
+  loader.join();
+}
+
+void extractor::load_all(
+  const std::vector<fsb::job_entry> & containers,
+  fsb::spsc_queue<std::unique_ptr<loaded_container>> & queue) {
+  // Upcoming containers are read into page cache in the background, while 
+  // the current one is being loaded.
+  const std::size_t readahead = 2;
+  std::size_t prefetched = 0;
+  for (std::size_t i = 0; i < containers.size(); ++i) {
+    for (; prefetched < containers.size() && prefetched <= i + readahead; 
+         ++prefetched) {
+      fsb::io::prefetch(containers[prefetched].path);
+    }
+    queue.push(load(containers[i]));
+  }
+  queue.push(nullptr);
+}
+
+void extractor::decrypt_all(
+  fsb::spsc_queue<std::unique_ptr<loaded_container>> & input,
+  fsb::spsc_queue<std::unique_ptr<loaded_container>> & output) {
+  while (std::unique_ptr<loaded_container> loaded = input.pop()) {
+    if (loaded->container && !loaded->error) {
+      try {
+        loaded->container->decrypt_data();
+      } catch (...) {
+        loaded->error = std::current_exception();
+      }
+    }
+    output.push(std::move(loaded));
+  }
+  output.push(nullptr);
+}
+
+std::unique_ptr<loaded_container> extractor::load(const fsb::job_entry & job) {
+  std::unique_ptr<loaded_container> loaded(new loaded_container());
+  loaded->job = job;
+  loaded->filter = options_.filter;
+  for (const auto & name : job.samples) {
+    loaded->filter.add_name(name);
+  }
+  try {
+    const boost::filesystem::path path = job.path;
+    fsb::manifest::container_entry & entry = loaded->entry;
+    entry.size = boost::filesystem::file_size(path);
+    entry.mtime = boost::filesystem::last_write_time(path);
     
-    auto & header = container.file_header();
-    std::cout << path.native() << std::endl;
-    print_header(std::cout, header);
-    std::cout << std::endl;
+    {
+      std::lock_guard<std::mutex> lock(manifest_mutex_);
+      const fsb::manifest::container_entry * const previous = 
+        manifest_.find(path.native());
+      if (previous) {
+        loaded->previous.reset(new fsb::manifest::container_entry(*previous));
+      }
+    }
+    const fsb::manifest::container_entry * const previous = 
+      loaded->previous.get();
+    // Container is extracted again if destination changed, or if any of its
+    // outputs was removed since.
+    entry.destination = destination_directory(options_, job).native();
+    if (options_.extract && previous && 
+        previous->size == entry.size && previous->mtime == entry.mtime &&
+        previous->destination == entry.destination && 
+        outputs_exist(*previous)) {
+      loaded->unchanged = true;
+      return loaded;
+    }
     
-    for (auto & sample : container.samples()) {
-      sample_number += 1;
-      
-      print_sample(std::cout, sample);
-      std::cout << std::endl;
-      
-      if (options.extract) {
-        const boost::filesystem::path path = options.destination / 
-          (std::to_string(sample_number) + "." + sample.name + ".ogg");
-        if (boost::filesystem::exists(path)) {
-          std::cerr 
-            << "Destination already exists, skipping: " 
-            << sample.name << std::endl;
-          continue;
+    std::ifstream stream;
+    {
+      fsb::trace::scoped_span span("open container", path.native());
+      stream.open(path.native(), std::ios_base::in | std::ios_base::binary);
+      if (!stream) {
+        throw fsb::error("Failed to open path: " + path.native());
+      }
+      loaded->container.reset(
+        new fsb::container(stream, options_.password, false));
+    }
+    const fsb::container & container = *loaded->container;
+    
+    // Unencrypted PCM and raw samples are copied directly from the container
+    // file, without passing through user space.
+    loaded->zero_copy = options_.password.empty() && !use_state_ && 
+      !store_ && (options_.raw || (container.is_pcm() && 
+        container.file_header().mode != fsb::format::pcm8));
+    // Only data that is buffered counts against the limit. Data is 
+    // decrypted by the next stage.
+    if (loaded->zero_copy) {
+      loaded->source = fsb::io::open_for_reading(path.native());
+    } else if (!loaded->filter.empty()) {
+      // Data of samples that are not selected is neither read nor decrypted.
+      const std::vector<const fsb::sample *> selected = 
+        loaded->filter.select(container.samples());
+      loaded->reserved = container.buffered_size(selected);
+      reserve(loaded->reserved);
+      loaded->container->read_data(stream, selected, false);
+    } else {
+      loaded->reserved = container.file_header().data_size;
+      reserve(loaded->reserved);
+      loaded->container->read_data(stream, false);
+    }
+  } catch (...) {
+    loaded->error = std::current_exception();
+  }
+  return loaded;
+}
+
+void extractor::reserve(std::uint64_t size) {
+  std::unique_lock<std::mutex> lock(buffered_mutex_);
+  // Container larger than the limit is loaded once nothing else is buffered.
+  buffered_released_.wait(lock, [&] {
+    return buffered_ == 0 || buffered_ + size <= options_.max_buffered;
+  });
+  buffered_ += size;
+}
+
+void extractor::release(std::uint64_t size) {
+  std::lock_guard<std::mutex> lock(buffered_mutex_);
+  buffered_ -= size;
+  buffered_released_.notify_all();
+}
+
+void extractor::process(loaded_container & loaded) {
+  containers_ += 1;
+  try {
+    if (loaded.error) {
+      std::rethrow_exception(loaded.error);
+    }
+    process_container(loaded);
+  } catch (const std::exception & e) {
+    failed_containers_ += 1;
+    report_failure(loaded.job.path, e.what());
+  }
+}
+
+int extractor::finish() {
+  if (use_state_ && options_.extract) {
+    write_manifest(options_.state, manifest_);
+  }
+  
+  if (chain_) {
+    try {
+      chain_->finish(options_.chain.native() + ".index");
+    } catch (const std::exception & e) {
+      failed_containers_ += 1;
+      report_failure(options_.chain.native(), e.what());
+    }
+  }
+  
+  if (fsb::stats::enabled()) {
+    write_stats(options_, fsb::stats::collect());
+  }
+  
+  if (fsb::trace::enabled()) {
+    std::ofstream stream(options_.trace.native());
+    fsb::trace::write_json(stream);
+    CHECK(stream.flush()) << "Failed to write trace: " << options_.trace;
+  }
+  
+  if (failed_containers_ || failed_samples_) {
+    std::cerr
+      << "Containers: " << containers_ - failed_containers_ << " processed, "
+      << failed_containers_ << " failed\n"
+      << "Samples:    " << samples_ << " extracted, "
+      << failed_samples_ << " failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+void extractor::report_failure(
+  const std::string & what, 
+  const std::string & reason, 
+  const boost::filesystem::path & output) {
+  std::lock_guard<std::mutex> lock(report_mutex_);
+  std::cerr << "Failed: " << what << ": " << reason << std::endl;
+  if (failures_.is_open()) {
+    failures_ << what << '\t' << reason << std::endl;
+  }
+  
+  // Do not leave partial output behind, keep it in quarantine for inspection.
+  boost::system::error_code ec;
+  if (!output.empty() && boost::filesystem::exists(output, ec)) {
+    if (!options_.quarantine.empty()) {
+      boost::filesystem::rename(
+        output, options_.quarantine / output.filename(), ec);
+    } else {
+      boost::filesystem::remove(output, ec);
+    }
+  }
+}
+
+void extractor::run_jobs(const std::vector<job> & jobs) {
+  const std::size_t threads = 
+    std::max<std::size_t>(1, std::min<std::size_t>(options_.jobs, jobs.size()));
+  while (rebuilders_.size() < threads) {
+    rebuilders_.emplace_back(new fsb::vorbis::rebuilder(options_.verify));
+  }
+  
+  std::atomic<std::size_t> next_job {0};
+  const auto worker = [&](fsb::vorbis::rebuilder & rebuilder) {
+    for (std::size_t i; (i = next_job++) < jobs.size(); ) {
+      try {
+        fsb::trace::scoped_span span("sample", jobs[i].name);
+        jobs[i].run(rebuilder);
+        samples_ += 1;
+        fsb::stats::add(fsb::stats::counter::samples);
+      } catch (const std::exception & e) {
+        {
+          std::lock_guard<std::mutex> lock(report_mutex_);
+          failed_samples_ += 1;
         }
+        report_failure(jobs[i].name, e.what(), jobs[i].output);
+      }
+    }
+  };
+  
+  std::vector<std::thread> workers;
+  for (std::size_t i = 1; i < threads; ++i) {
+    workers.emplace_back(worker, std::ref(*rebuilders_[i]));
+  }
+  worker(*rebuilders_[0]);
+  for (auto & thread : workers) {
+    thread.join();
+  }
+}
 
-        std::ofstream output(path.native());
-        CHECK(output) << "Failed to open output file: " << path;
-        container.extract_sample(sample, output);
+void extractor::process_container(loaded_container & loaded) {
+  const fsb::job_entry & job_entry = loaded.job;
+  const boost::filesystem::path path = job_entry.path;
+  fsb::manifest::container_entry & entry = loaded.entry;
+  const fsb::manifest::container_entry * const previous = 
+    loaded.previous.get();
+  if (loaded.unchanged) {
+    std::cerr 
+      << "Container unchanged, skipping: " 
+      << path.native() << std::endl;
+    sample_number_ += previous->samples.size();
+    return;
+  }
+  
+  fsb::container & container = *loaded.container;
+  const bool zero_copy = loaded.zero_copy;
+  const fsb::io::unique_fd & source = loaded.source;
+  
+  auto & header = container.file_header();
+  std::cout << path.native() << std::endl;
+  print_header(std::cout, header);
+  std::cout << std::endl;
+  
+  if (chain_ && options_.extract && header.mode != fsb::format::vorbis) {
+    throw fsb::error("Only Vorbis samples can be chained.");
+  }
+  
+  entry.guid = fsb::manifest::guid_string(header);
+  // Container was modified, but has the same content as before.
+  const bool same_content = previous && 
+    previous->size == entry.size && previous->guid == entry.guid &&
+    previous->samples.size() == header.samples;
+  
+  // Extraction jobs, run in parallel after listing container content.
+  std::vector<job> jobs;
+  // Links to samples in the store, created after all jobs are finished.
+  std::vector<std::pair<std::string, boost::filesystem::path>> links;
+  std::set<std::string> scheduled_keys;
+  // Rebuilt samples that are appended to chained output in order, after all
+  // jobs are finished.
+  std::vector<std::string> chained;
+  std::vector<std::pair<std::uint32_t, const fsb::sample *>> chained_samples;
+  std::vector<char> chained_done;
+  if (chain_) {
+    chained.resize(header.samples);
+    chained_done.resize(header.samples);
+  }
+  
+  const boost::filesystem::path destination = entry.destination;
+  if (options_.extract && !job_entry.destination.empty()) {
+    boost::filesystem::create_directories(destination);
+  }
+  const fsb::sample_filter & filter = loaded.filter;
+  // Failed samples of this container are counted from here.
+  const std::size_t failed_samples = failed_samples_;
+  
+  for (std::size_t i = 0; i < container.samples().size(); ++i) {
+    const fsb::sample & sample = container.samples()[i];
+    sample_number_ += 1;
+    if (!filter.matches(i, sample.name)) {
+      continue;
+    }
+    
+    const boost::filesystem::path path = destination / 
+      (std::to_string(sample_number_) + "." + sample.name.to_string() + 
+       (options_.raw ? ".raw" :
+        options_.wav || container.is_pcm() ? ".wav" : ".ogg"));
+    
+    // Duration is not known for samples that are not read into memory.
+    std::uint64_t duration = fsb::unknown_duration;
+    try {
+      if (header.mode == fsb::format::vorbis && container.has_data(sample)) {
+        duration = container.sample_duration(sample);
       }
+    } catch (const std::exception & e) {
+      if (options_.extract) {
+        // Sample is still extracted. Raw samples need no duration, and
+        // extraction of other ones reports its own failure.
+        std::cerr 
+          << "Duration unknown: " << path.native() << ": " << e.what() 
+          << std::endl;
+      } else {
+        failed_samples_ += 1;
+        report_failure(path.native(), e.what());
+      }
+    }
+    fsb::write_sample_description(std::cout, sample, duration);
+    std::cout << std::endl;
+    
+    if (!options_.extract) {
+      continue;
+    }
+    
+    const fsb::sample * const sample_ptr = &sample;
+    if (chain_) {
+      // Sample number is used as a serial number, unique within chain.
+      const std::size_t slot = chained_samples.size();
+      const int serial = static_cast<int>(sample_number_);
+      chained_samples.emplace_back(sample_number_, sample_ptr);
+      jobs.push_back({path.native(), {}, [&, slot, serial, sample_ptr](
+          fsb::vorbis::rebuilder & rebuilder) {
+        std::ostringstream output;
+        rebuilder.rebuild(
+          *sample_ptr, container.sample_view(*sample_ptr), output, serial);
+        chained[slot] = output.str();
+        chained_done[slot] = true;
+      }});
+      continue;
+    }
+    
+    bool changed = true;
+    if (use_state_) {
+      if (same_content) {
+        entry.samples.push_back(previous->samples[i]);
+        changed = false;
+      } else {
+        entry.samples.push_back(fsb::manifest::make_sample_entry(
+          sample, container.sample_view(sample)));
+        changed = !previous || i >= previous->samples.size() ||
+          previous->samples[i] != entry.samples.back();
+      }
+      entry.samples.back().output = path.native();
+    }
+    
+    if (boost::filesystem::exists(path) && !(use_state_ && changed)) {
+      std::cerr 
+        << "Destination already exists, skipping: " 
+        << sample.name << std::endl;
+      continue;
     }
+    
+    if (store_) {
+      // Sample is rebuilt only if there is no identical one in the store.
+      const std::string key = fsb::content_store::key(
+        container.file_header().mode, sample, container.sample_view(sample));
+      if (!scheduled_keys.count(key) && !store_->contains(key)) {
+        scheduled_keys.insert(key);
+        jobs.push_back({path.native(), path, [&, key, sample_ptr](
+            fsb::vorbis::rebuilder & rebuilder) {
+          store_->insert(key, [&](std::ostream & output) {
+            container.extract_sample(*sample_ptr, output, rebuilder);
+          });
+        }});
+      }
+      links.emplace_back(key, path);
+      if (use_state_ && store_manifest_.is_open()) {
+        // Links are created by the consumer of store manifest, only the 
+        // stored sample is an output of extractor.
+        entry.samples.back().output = store_->object_path(key).native();
+      }
+    } else if (options_.raw) {
+      jobs.push_back({path.native(), path, [&, path, sample_ptr, duration](
+          fsb::vorbis::rebuilder &) {
+        fsb::write_raw(container, *sample_ptr, duration, 
+          zero_copy ? source.get() : -1, path.native());
+      }});
+    } else if (zero_copy) {
+      jobs.push_back({path.native(), path, [&, path, sample_ptr](
+          fsb::vorbis::rebuilder &) {
+        copy_pcm(container, *sample_ptr, source.get(), path);
+      }});
+    } else {
+      jobs.push_back({path.native(), path, [&, path, sample_ptr](
+          fsb::vorbis::rebuilder & rebuilder) {
+        write_sample(container, *sample_ptr, options_.wav, rebuilder, path);
+      }});
+    }
+  }
+  
+  run_jobs(jobs);
+  
+  for (std::size_t i = 0; i < chained_samples.size(); ++i) {
+    if (chained_done[i]) {
+      chain_->append(
+        chained_samples[i].first, 
+        path.native() + ':' + chained_samples[i].second->name.to_string(), 
+        chained[i]);
+      std::string().swap(chained[i]);
+    }
+  }
+  
+  for (const auto & link : links) {
+    const std::string & key = link.first;
+    const boost::filesystem::path & path = link.second;
+    if (!store_->contains(key)) {
+      // Failure was already reported by the job.
+      continue;
+    }
+    if (store_manifest_.is_open()) {
+      store_manifest_ << key << '\t' << path.native() << '\n';
+    } else {
+      boost::filesystem::remove(path);
+      boost::filesystem::create_hard_link(store_->object_path(key), path);
+    }
+  }
+  
+  // Partially extracted containers are not recorded as done, neither are
+  // those with failed samples, so that the samples are retried next time.
+  if (use_state_ && options_.extract && filter.empty() && 
+      failed_samples_ == failed_samples) {
+    std::lock_guard<std::mutex> lock(manifest_mutex_);
+    manifest_.insert(path.native(), std::move(entry));
+  }
+}
+
+}
+
+// Prints passwords recovered from headers of containers. Returns exit status.
+int recover_passwords(const extractor_options & options) {
+  // Headers of containers are at the beginning, and are rarely that large.
+  const std::size_t max_prefix_size = 16 << 20;
+  int status = EXIT_SUCCESS;
+  for (const auto & job : options.containers) {
+    std::ifstream stream(job.path, std::ios_base::in | std::ios_base::binary);
+    if (!stream) {
+      std::cerr << "Failed to open path: " << job.path << std::endl;
+      status = EXIT_FAILURE;
+      continue;
+    }
+    std::string prefix(max_prefix_size, '\0');
+    stream.read(&prefix[0], prefix.size());
+    prefix.resize(stream.gcount());
+    
+    const std::vector<std::string> passwords = fsb::recover_password(
+      prefix, boost::filesystem::file_size(job.path));
+    if (passwords.empty()) {
+      std::cerr << "Password not found: " << job.path << std::endl;
+      status = EXIT_FAILURE;
+    }
+    for (const auto & password : passwords) {
+      std::cout << job.path << '\t' << password << '\n';
+    }
+  }
+  return status;
+}
+
+// Writes the only selected sample of a container to standard output, keeping
+// everything else off it. Returns exit status.
+int extract_to_stdout(const extractor_options & options) {
+  const fsb::job_entry & job = options.containers.front();
+  fsb::sample_filter filter = options.filter;
+  for (const auto & name : job.samples) {
+    filter.add_name(name);
+  }
+  
+  try {
+    std::ifstream stream(job.path, std::ios_base::in | std::ios_base::binary);
+    if (!stream) {
+      throw fsb::error("Failed to open path: " + job.path);
+    }
+    fsb::container container(stream, options.password, false);
+    const std::vector<const fsb::sample *> selected = 
+      filter.select(container.samples());
+    if (selected.size() != 1) {
+      throw fsb::error("Exactly one sample must be selected, " + 
+        std::to_string(selected.size()) + " were.");
+    }
+    container.read_data(stream, selected);
+    
+    fsb::io::fd_buffer buffer(STDOUT_FILENO);
+    std::ostream output(&buffer);
+    if (options.wav && !container.is_pcm()) {
+      write_wav(container, *selected.front(), output);
+    } else {
+      fsb::vorbis::rebuilder rebuilder(options.verify);
+      container.extract_sample(*selected.front(), output, rebuilder);
+    }
+    if (!output.flush()) {
+      throw fsb::error("Failed to write standard output.");
+    }
+  } catch (const std::exception & e) {
+    std::cerr << "Failed: " << job.path << ": " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// Serves extraction requests until interrupted by SIGINT or SIGTERM.
+void serve(const extractor_options & options) {
+  // Signals are blocked in all threads and received synchronously instead.
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  CHECK(pthread_sigmask(SIG_BLOCK, &signals, nullptr) == 0);
+  
+  fsb::server server(
+    options.serve.native(), options.cache, options.password,
+    options.max_connections);
+  std::thread waiter([&] {
+    int signal;
+    sigwait(&signals, &signal);
+    server.stop();
+  });
+  
+  std::cerr << "Listening on " << options.serve.native() << std::endl;
+  try {
+    server.run();
+  } catch (...) {
+    ::kill(::getpid(), SIGTERM);
+    waiter.join();
+    throw;
   }
+  waiter.join();
+}
+
+int main(int argc, char **argv) {
+  google::InitGoogleLogging(argv[0]);
+
+  const extractor_options options = parse_options(argc, argv);
+  if (options.recover_password) {
+    return recover_passwords(options);
+  }
+  if (options.to_stdout) {
+    return extract_to_stdout(options);
+  }
+  if (!options.stats.empty() || !options.stats_prometheus.empty()) {
+    fsb::stats::enable();
+  }
+  if (!options.trace.empty()) {
+    fsb::trace::enable();
+  }
+  
+  extractor extractor(options);
+  if (!options.serve.empty()) {
+    serve(options);
+  }
+  
+  extractor.run(options.containers);
   
-  return 0;
+  return extractor.finish();
 }
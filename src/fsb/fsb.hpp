@@ -66,8 +66,9 @@ struct header {
 
 // FSB sample.
 struct sample {
-  // Sample name.
-  std::string name;
+  // Sample name, a view on names table owned by container. Name is followed 
+  // by a null character.
+  boost::string_ref name;
   // Sample rate.
   std::uint32_t frequency = 0;
   // Number of channels in sample.
@@ -80,6 +81,8 @@ struct sample {
   std::uint32_t vorbis_crc32 = 0;
   std::uint32_t loop_start = 0;
   std::uint32_t loop_end = 0;
+  // Largest granule position in Vorbis seek table, zero if there is none.
+  std::uint32_t seek_granulepos = 0;
   std::uint32_t unknown = 0;
 };
 
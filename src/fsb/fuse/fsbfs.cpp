@@ -0,0 +1,255 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#define FUSE_USE_VERSION 26
+
+#include "fsb/mounted_bank.hpp"
+
+#include <boost/filesystem.hpp>
+#include <glog/logging.h>
+#include <fuse.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace {
+
+// Container exposed as a directory.
+struct bank_entry {
+  std::string path;
+  std::time_t mtime;
+  // Opened on first access.
+  std::unique_ptr<fsb::mounted_bank> bank;
+};
+
+struct filesystem {
+  std::string password;
+  std::size_t cached_segments = 64;
+  // Banks indexed by directory name.
+  std::map<std::string, bank_entry> banks;
+  std::mutex mutex;
+};
+
+filesystem & this_filesystem() {
+  return *static_cast<filesystem*>(fuse_get_context()->private_data);
+}
+
+// Splits path into names of directory and file, both of which may be empty.
+void split_path(const char * path, std::string & directory, std::string & file) {
+  const char * const begin = path + (*path == '/');
+  const char * const slash = std::strchr(begin, '/');
+  directory.assign(begin, slash ? slash : begin + std::strlen(begin));
+  file.assign(slash ? slash + 1 : "");
+}
+
+// Returns entry of a bank with given directory name, opening the bank if 
+// necessary, or null if there is none.
+bank_entry * open_bank(const std::string & directory) {
+  filesystem & fs = this_filesystem();
+  const auto it = fs.banks.find(directory);
+  if (it == fs.banks.end()) {
+    return nullptr;
+  }
+  bank_entry & entry = it->second;
+  std::lock_guard<std::mutex> lock(fs.mutex);
+  if (!entry.bank) {
+    entry.bank.reset(
+      new fsb::mounted_bank(entry.path, fs.password, fs.cached_segments));
+  }
+  return &entry;
+}
+
+// Calls function and converts exceptions into error codes.
+template <typename Function>
+int guarded(const char * path, Function function) {
+  try {
+    return function();
+  } catch (const std::exception & e) {
+    LOG(ERROR) << path << ": " << e.what();
+    return -EIO;
+  }
+}
+
+int fsbfs_getattr(const char * path, struct stat * stat) {
+  return guarded(path, [&] {
+    std::memset(stat, 0, sizeof(*stat));
+    std::string directory, file;
+    split_path(path, directory, file);
+    if (directory.empty()) {
+      stat->st_mode = S_IFDIR | 0555;
+      stat->st_nlink = 2 + this_filesystem().banks.size();
+      return 0;
+    }
+    bank_entry * const entry = open_bank(directory);
+    if (!entry) {
+      return -ENOENT;
+    }
+    stat->st_mtime = entry->mtime;
+    if (file.empty()) {
+      stat->st_mode = S_IFDIR | 0555;
+      stat->st_nlink = 2;
+      return 0;
+    }
+    const long index = entry->bank->find_file(file);
+    if (index < 0) {
+      return -ENOENT;
+    }
+    stat->st_mode = S_IFREG | 0444;
+    stat->st_nlink = 1;
+    // Size is computed from sizes of packets on first use, without muxing.
+    stat->st_size = entry->bank->file_size(index);
+    return 0;
+  });
+}
+
+int fsbfs_readdir(
+  const char * path, void * buffer, fuse_fill_dir_t filler, off_t, 
+  struct fuse_file_info *) {
+  return guarded(path, [&] {
+    std::string directory, file;
+    split_path(path, directory, file);
+    if (!file.empty()) {
+      return -ENOTDIR;
+    }
+    filler(buffer, ".", nullptr, 0);
+    filler(buffer, "..", nullptr, 0);
+    if (directory.empty()) {
+      for (const auto & bank : this_filesystem().banks) {
+        filler(buffer, bank.first.c_str(), nullptr, 0);
+      }
+      return 0;
+    }
+    bank_entry * const entry = open_bank(directory);
+    if (!entry) {
+      return -ENOENT;
+    }
+    for (const auto & name : entry->bank->file_names()) {
+      filler(buffer, name.c_str(), nullptr, 0);
+    }
+    return 0;
+  });
+}
+
+int fsbfs_open(const char * path, struct fuse_file_info * info) {
+  return guarded(path, [&] {
+    std::string directory, file;
+    split_path(path, directory, file);
+    bank_entry * const entry = open_bank(directory);
+    if (!entry || file.empty() || entry->bank->find_file(file) < 0) {
+      return -ENOENT;
+    }
+    if ((info->flags & O_ACCMODE) != O_RDONLY) {
+      return -EACCES;
+    }
+    // Content never changes, page cache of the kernel can be kept.
+    info->keep_cache = 1;
+    return 0;
+  });
+}
+
+int fsbfs_read(
+  const char * path, char * buffer, size_t size, off_t offset,
+  struct fuse_file_info *) {
+  return guarded(path, [&] {
+    std::string directory, file;
+    split_path(path, directory, file);
+    bank_entry * const entry = open_bank(directory);
+    const long index = entry ? entry->bank->find_file(file) : -1;
+    if (index < 0) {
+      return -ENOENT;
+    }
+    return static_cast<int>(entry->bank->read(index, offset, buffer, size));
+  });
+}
+
+void usage(const char *name) {
+  std::cout <<
+    "Usage: " << name << " [OPTION]... FSB_FILE... MOUNTPOINT [FUSE_OPTION]...\n"
+    "Mounts FSB5 containers as directories of Ogg files. Samples are rebuilt\n"
+    "on demand, only in parts that are read.\n"
+    "\n"
+    "Options:\n"
+    "  -h --help         display this help and exit\n"
+    "  -p --password     password used to encode FSB files\n"
+    "     --cache        number of rebuilt segments of about 64 KiB kept in\n"
+    "                    memory for each container, 64 by default\n"
+    "\n"
+    "Remaining options starting with - are passed to FUSE.\n";
+}
+
+}
+
+int main(int argc, char **argv) {
+  google::InitGoogleLogging(argv[0]);
+  
+  filesystem fs;
+  // Paths point into argv, which outlives fuse_main.
+  std::vector<char *> paths;
+  std::vector<char *> fuse_args {argv[0]};
+  for (int argi = 1; argi < argc; ++argi) {
+    const char *arg = argv[argi];
+    if (std::strcmp("--help", arg) == 0 || std::strcmp("-h", arg) == 0) {
+      usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (std::strcmp("--password", arg) == 0 || std::strcmp("-p", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      fs.password = argv[++argi];
+    } else if (std::strcmp("--cache", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      fs.cached_segments = std::max(1, std::atoi(argv[++argi]));
+    } else if (std::strcmp("-o", arg) == 0) {
+      CHECK(argi + 1 < argc) << "An argument is required for " << arg << '.';
+      fuse_args.push_back(argv[argi]);
+      fuse_args.push_back(argv[++argi]);
+    } else if (arg[0] == '-') {
+      fuse_args.push_back(argv[argi]);
+    } else {
+      paths.push_back(argv[argi]);
+    }
+  }
+  if (paths.size() < 2) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  
+  // The last path is a mount point, the remaining ones are containers.
+  fuse_args.insert(fuse_args.begin() + 1, paths.back());
+  paths.pop_back();
+  for (const char * path : paths) {
+    const std::string name = boost::filesystem::path(path).filename().native();
+    bank_entry & entry = fs.banks[name];
+    CHECK(entry.path.empty()) << "Containers with the same name: " << name;
+    entry.path = path;
+    entry.mtime = boost::filesystem::last_write_time(path);
+  }
+  
+  struct fuse_operations operations {};
+  operations.getattr = fsbfs_getattr;
+  operations.readdir = fsbfs_readdir;
+  operations.open = fsbfs_open;
+  operations.read = fsbfs_read;
+  
+  return fuse_main(
+    static_cast<int>(fuse_args.size()), fuse_args.data(), &operations, &fs);
+}
@@ -12,7 +12,9 @@
 //
 #include "fsb/io/buffer_view.hpp"
 
-#include <glog/logging.h>
+#include "fsb/error.hpp"
+
+#include <string>
 
 namespace fsb { namespace io {
   
@@ -29,58 +31,55 @@ buffer_view::buffer_view(const char * begin, const char * end)
 {}
 
 void buffer_view::set_offset(std::size_t offset) {
-  CHECK(offset <= size());
+  if (offset > size()) {
+    throw error("Offset " + std::to_string(offset) + 
+      " is past the end of buffer of size " + std::to_string(size()) + ".");
+  }
   current_ = begin_ + offset;
 }
 
 void buffer_view::skip(std::size_t length) {
-  CHECK(remaining() >= length);
+  require(length);
   current_ += length;
 }
 
 const char * buffer_view::read(std::size_t length) {
-  CHECK(remaining() >= length);
+  require(length);
   const char * const result = current_;
   current_ += length;
   return result;
 }
 
 char buffer_view::read_char() {
-  CHECK(remaining() >= 1u);
+  require(1u);
   return *current_++;
 }
 
 uint8_t buffer_view::read_uint8() {
-  CHECK(remaining() >= 1u);
-  return *current_++;
+  return read<std::uint8_t>();
 }
 
 uint16_t buffer_view::read_uint16() {
-CHECK(remaining() >= 2u);
-  const uint16_t x = read_uint8();
-  const uint16_t y = read_uint8();
-  return x + (y << 8u);
+  return read<std::uint16_t>();
 }
 
 uint32_t buffer_view::read_uint24() {
-  CHECK(remaining() >= 3u);
-  const uint32_t x = read_uint8();
-  const uint32_t y = read_uint16();
-  return x + (y << 8u);
+  require(3u);
+  return read_uint24_unchecked();
 }
 
 uint32_t buffer_view::read_uint32() {
-  CHECK(remaining() >= 4u);
-  const uint32_t x = read_uint16();
-  const uint32_t y = read_uint16();
-  return x + (y << 16u);
+  return read<std::uint32_t>();
 }
 
 uint64_t buffer_view::read_uint64() {
-  CHECK(remaining() >= 8u);
-  const uint64_t x = read_uint32();
-  const uint64_t y = read_uint32();
-  return x + (y << 32u);
+  return read<std::uint64_t>();
+}
+
+void buffer_view::out_of_range(std::size_t length) const {
+  throw error("Read of " + std::to_string(length) + 
+    " bytes past the end of buffer, only " + std::to_string(remaining()) +
+    " bytes remaining.");
 }
   
 }}
@@ -15,9 +15,43 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 namespace fsb { namespace io {
 
+namespace detail {
+
+// Converts little-endian integer to host byte order.
+inline std::uint8_t from_little_endian(std::uint8_t x) {
+  return x;
+}
+
+inline std::uint16_t from_little_endian(std::uint16_t x) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return __builtin_bswap16(x);
+#else
+  return x;
+#endif
+}
+
+inline std::uint32_t from_little_endian(std::uint32_t x) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return __builtin_bswap32(x);
+#else
+  return x;
+#endif
+}
+
+inline std::uint64_t from_little_endian(std::uint64_t x) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return __builtin_bswap64(x);
+#else
+  return x;
+#endif
+}
+
+}
+
 // View on sequence of bytes that allows to read them as integers of different 
 // sizes. Holds and offset within buffer that is updated by a number of bytes
 // read, after each read operation.
@@ -82,6 +116,41 @@ public:
   // Reads 64-bit unsigned integer.
   std::uint64_t read_uint64();
   
+  // Reads little-endian unsigned integer of type T.
+  template <typename T>
+  T read() {
+    require(sizeof(T));
+    return read_unchecked<T>();
+  }
+  
+  // Checks that at least length bytes remain in the buffer. Unchecked reads
+  // of up to length bytes in total are safe afterwards.
+  void require(std::size_t length) const {
+    if (remaining() < length) {
+      out_of_range(length);
+    }
+  }
+  
+  // Reads little-endian unsigned integer of type T, without bounds checking.
+  template <typename T>
+  T read_unchecked() {
+    T x;
+    std::memcpy(&x, current_, sizeof(T));
+    current_ += sizeof(T);
+    return detail::from_little_endian(x);
+  }
+  
+  // Reads 24-bit unsigned integer, without bounds checking.
+  std::uint32_t read_uint24_unchecked() {
+    const std::uint32_t x = read_unchecked<std::uint8_t>();
+    const std::uint32_t y = read_unchecked<std::uint16_t>();
+    return x | (y << 8u);
+  }
+  
+private:
+  // Throws error reporting attempt to read past the end of buffer.
+  [[noreturn]] void out_of_range(std::size_t length) const;
+  
 private:
   const char * begin_;
   const char * end_;
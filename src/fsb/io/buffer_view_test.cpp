@@ -0,0 +1,67 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/io/buffer_view.hpp"
+
+#include "fsb/error.hpp"
+
+#include <gtest/gtest.h>
+
+using fsb::io::buffer_view;
+
+namespace {
+
+const char data[] {
+  0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+  static_cast<char>(0xff), static_cast<char>(0xfe)};
+
+TEST(buffer_view_test, reads_little_endian_integers) {
+  buffer_view view(data, sizeof(data));
+  ASSERT_EQ(0x01u, view.read_uint8());
+  ASSERT_EQ(0x0302u, view.read_uint16());
+  ASSERT_EQ(0x060504u, view.read_uint24());
+  ASSERT_EQ(0xfeff0807u, view.read_uint32());
+  ASSERT_EQ(0u, view.remaining());
+  
+  view.set_offset(0);
+  ASSERT_EQ(0x0807060504030201u, view.read_uint64());
+}
+
+TEST(buffer_view_test, templated_reads_match_sized_reads) {
+  buffer_view view(data, sizeof(data));
+  ASSERT_EQ(0x01u, view.read<std::uint8_t>());
+  ASSERT_EQ(0x0302u, view.read<std::uint16_t>());
+  view.set_offset(2);
+  ASSERT_EQ(0x06050403u, view.read<std::uint32_t>());
+  view.set_offset(1);
+  ASSERT_EQ(0xff08070605040302u, view.read<std::uint64_t>());
+}
+
+TEST(buffer_view_test, unchecked_reads_after_require) {
+  buffer_view view(data, sizeof(data));
+  view.require(8);
+  ASSERT_EQ(0x01u, view.read_unchecked<std::uint8_t>());
+  ASSERT_EQ(0x040302u, view.read_uint24_unchecked());
+  ASSERT_EQ(0x08070605u, view.read_unchecked<std::uint32_t>());
+  ASSERT_EQ(2u, view.remaining());
+}
+
+TEST(buffer_view_test, read_past_end) {
+  buffer_view view(data, sizeof(data));
+  view.set_offset(7);
+  ASSERT_THROW(view.read<std::uint32_t>(), fsb::error);
+  ASSERT_THROW(view.require(4), fsb::error);
+  ASSERT_THROW(view.set_offset(11), fsb::error);
+  ASSERT_EQ(7u, view.offset());
+}
+
+}
@@ -0,0 +1,244 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/io/file.hpp"
+
+#include "fsb/error.hpp"
+#include "fsb/stats.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+
+namespace fsb { namespace io {
+
+namespace {
+
+// Throws error with given message followed by description of errno.
+[[noreturn]] void throw_system_error(const std::string & message) {
+  throw error(message + ": " + (errno ? std::strerror(errno) : "end of file"));
+}
+
+// Writes exactly size bytes, without accounting them in statistics.
+void write_all(int fd, const char * buffer, std::size_t size) {
+  while (size > 0) {
+    const ssize_t written = ::write(fd, buffer, size);
+    if (written == -1 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      throw_system_error("Write failed");
+    }
+    buffer += written;
+    size -= written;
+  }
+}
+
+}
+
+unique_fd::unique_fd(int fd)
+  : fd_(fd) {
+}
+
+unique_fd::unique_fd(unique_fd && other)
+  : fd_(other.fd_) {
+  other.fd_ = -1;
+}
+
+unique_fd & unique_fd::operator=(unique_fd && other) {
+  std::swap(fd_, other.fd_);
+  return *this;
+}
+
+unique_fd::~unique_fd() {
+  if (fd_ != -1) {
+    ::close(fd_);
+  }
+}
+
+void unique_fd::close() {
+  const int fd = fd_;
+  fd_ = -1;
+  errno = 0;
+  if (fd != -1 && ::close(fd) == -1 && errno != EINTR) {
+    throw_system_error("Failed to close file");
+  }
+}
+
+fd_buffer::fd_buffer(int fd, std::size_t block_size)
+  : fd_(fd)
+  , buffer_(block_size) {
+  setp(buffer_.data(), buffer_.data() + buffer_.size());
+#ifdef F_SETPIPE_SZ
+  // Fails for other kinds of files, or if size exceeds the system limit.
+  ::fcntl(fd_, F_SETPIPE_SZ, static_cast<int>(block_size));
+#endif
+}
+
+fd_buffer::~fd_buffer() {
+  write_buffer();
+}
+
+fd_buffer::int_type fd_buffer::overflow(int_type c) {
+  if (!write_buffer()) {
+    return traits_type::eof();
+  }
+  if (!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+std::streamsize fd_buffer::xsputn(const char * data, std::streamsize size) {
+  // Data that does not fit into the buffer is written directly.
+  if (size > epptr() - pptr()) {
+    if (!write_buffer()) {
+      return 0;
+    }
+    if (static_cast<std::size_t>(size) >= buffer_.size()) {
+      try {
+        write_all(fd_, data, size);
+      } catch (const error &) {
+        return 0;
+      }
+      return size;
+    }
+  }
+  traits_type::copy(pptr(), data, size);
+  pbump(static_cast<int>(size));
+  return size;
+}
+
+int fd_buffer::sync() {
+  return write_buffer() ? 0 : -1;
+}
+
+bool fd_buffer::write_buffer() {
+  const std::size_t size = pptr() - pbase();
+  setp(buffer_.data(), buffer_.data() + buffer_.size());
+  try {
+    write_all(fd_, buffer_.data(), size);
+  } catch (const error &) {
+    return false;
+  }
+  return true;
+}
+
+unique_fd open_for_reading(const std::string & path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    throw_system_error("Failed to open path: " + path);
+  }
+  return unique_fd(fd);
+}
+
+unique_fd open_for_writing(const std::string & path) {
+  const int fd = ::open(path.c_str(),
+    O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  if (fd == -1) {
+    throw_system_error("Failed to open output file: " + path);
+  }
+  return unique_fd(fd);
+}
+
+void write(int fd, const char * buffer, std::size_t size) {
+  stats::scoped_timer timer(stats::stage::write);
+  stats::add(stats::counter::bytes_written, size);
+  write_all(fd, buffer, size);
+}
+
+namespace {
+
+// Returns true if error indicates that given copying method is not supported
+// for given pair of files, and the next one should be tried instead.
+bool is_unsupported(int error) {
+  return error == ENOSYS || error == EXDEV || error == EINVAL || 
+    error == EOPNOTSUPP || error == EBADF;
+}
+
+}
+
+void copy_range(
+  int input_fd, std::uint64_t offset, int output_fd, std::uint64_t size) {
+  
+  stats::scoped_timer timer(stats::stage::write);
+  stats::add(stats::counter::bytes_written, size);
+  loff_t input_offset = offset;
+  
+  // Copy within file system, possibly without touching the data at all.
+  while (size > 0) {
+    errno = 0;
+    const ssize_t copied = ::copy_file_range(
+      input_fd, &input_offset, output_fd, nullptr, size, 0);
+    if (copied == -1 && errno == EINTR) {
+      continue;
+    }
+    if (copied == -1 && is_unsupported(errno)) {
+      break;
+    }
+    if (copied <= 0) {
+      throw_system_error("copy_file_range failed");
+    }
+    size -= copied;
+  }
+  
+  // Copy between file systems, data still does not leave the kernel.
+  off_t sendfile_offset = input_offset;
+  while (size > 0) {
+    errno = 0;
+    const ssize_t copied = ::sendfile(
+      output_fd, input_fd, &sendfile_offset, size);
+    if (copied == -1 && errno == EINTR) {
+      continue;
+    }
+    if (copied == -1 && is_unsupported(errno)) {
+      break;
+    }
+    if (copied <= 0) {
+      throw_system_error("sendfile failed");
+    }
+    size -= copied;
+  }
+  
+  // Fallback to user space copy.
+  off_t read_offset = sendfile_offset;
+  char buffer[64 * 1024];
+  while (size > 0) {
+    const std::size_t to_read = size < sizeof(buffer) ? size : sizeof(buffer);
+    errno = 0;
+    const ssize_t bytes = ::pread(input_fd, buffer, to_read, read_offset);
+    if (bytes == -1 && errno == EINTR) {
+      continue;
+    }
+    if (bytes <= 0) {
+      throw_system_error("Read failed");
+    }
+    write_all(output_fd, buffer, bytes);
+    read_offset += bytes;
+    size -= bytes;
+  }
+}
+
+void prefetch(const std::string & path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd != -1) {
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    ::close(fd);
+  }
+}
+
+}}
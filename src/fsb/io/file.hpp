@@ -0,0 +1,95 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_IO_FILE_HPP
+#define FSB_IO_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace fsb { namespace io {
+
+// Owns a file descriptor and closes it on destruction.
+class unique_fd {
+  unique_fd(const unique_fd &) = delete;
+  unique_fd & operator=(const unique_fd &) = delete;
+public:
+  explicit unique_fd(int fd = -1);
+  unique_fd(unique_fd && other);
+  unique_fd & operator=(unique_fd && other);
+  ~unique_fd();
+  
+  // Closes owned file descriptor, reporting errors of delayed writes.
+  void close();
+  
+  // Returns owned file descriptor.
+  int get() const {
+    return fd_;
+  }
+  
+private:
+  int fd_;
+};
+
+// Output stream buffer writing to a file descriptor in large blocks. File
+// descriptor is not owned. When it refers to a pipe, capacity of the pipe is
+// increased to the block size, if permitted.
+class fd_buffer : public std::streambuf {
+  fd_buffer(const fd_buffer &) = delete;
+  fd_buffer & operator=(const fd_buffer &) = delete;
+public:
+  explicit fd_buffer(int fd, std::size_t block_size = 1 << 20);
+  
+  // Writes buffered data, ignoring errors. Use pubsync to detect them.
+  ~fd_buffer();
+  
+protected:
+  int_type overflow(int_type c) override;
+  std::streamsize xsputn(const char * data, std::streamsize size) override;
+  int sync() override;
+  
+private:
+  // Writes buffered data. Returns false on failure.
+  bool write_buffer();
+  
+private:
+  const int fd_;
+  std::vector<char> buffer_;
+};
+
+// Opens existing file for reading.
+unique_fd open_for_reading(const std::string & path);
+
+// Creates or truncates file and opens it for writing.
+unique_fd open_for_writing(const std::string & path);
+
+// Writes exactly size bytes from a buffer to a file descriptor.
+void write(int fd, const char * buffer, std::size_t size);
+
+// Copies size bytes, starting at given offset of input file, to the current
+// position of output file. 
+//
+// Data is copied inside the kernel with copy_file_range or sendfile where
+// possible, and through a user space buffer otherwise.
+void copy_range(
+  int input_fd, std::uint64_t offset, int output_fd, std::uint64_t size);
+
+// Asks kernel to start reading a file into page cache in the background. 
+// Errors are ignored, as this is only a hint.
+void prefetch(const std::string & path);
+
+}}
+
+#endif
@@ -0,0 +1,81 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/io/file.hpp"
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <iterator>
+#include <ostream>
+
+namespace {
+
+std::string read_file(const boost::filesystem::path & path) {
+  std::ifstream stream(path.native(), std::ios_base::binary);
+  return std::string(
+    std::istreambuf_iterator<char>(stream),
+    std::istreambuf_iterator<char>());
+}
+
+TEST(copy_range_test, copies_range_after_header) {
+  const boost::filesystem::path input =
+    boost::filesystem::temp_directory_path() /
+    boost::filesystem::unique_path("fsb-input-%%%%-%%%%");
+  const boost::filesystem::path output =
+    boost::filesystem::temp_directory_path() /
+    boost::filesystem::unique_path("fsb-output-%%%%-%%%%");
+  
+  {
+    std::ofstream stream(input.native(), std::ios_base::binary);
+    stream << "0123456789";
+  }
+  
+  {
+    const fsb::io::unique_fd input_fd = 
+      fsb::io::open_for_reading(input.native());
+    const fsb::io::unique_fd output_fd = 
+      fsb::io::open_for_writing(output.native());
+    fsb::io::write(output_fd.get(), "head:", 5);
+    fsb::io::copy_range(input_fd.get(), 3, output_fd.get(), 4);
+  }
+  
+  ASSERT_EQ("head:3456", read_file(output));
+  
+  boost::filesystem::remove(input);
+  boost::filesystem::remove(output);
+}
+
+TEST(fd_buffer_test, writes_in_order) {
+  const boost::filesystem::path output =
+    boost::filesystem::temp_directory_path() /
+    boost::filesystem::unique_path("fsb-output-%%%%-%%%%");
+  const std::string large(100, 'x');
+  
+  {
+    const fsb::io::unique_fd output_fd = 
+      fsb::io::open_for_writing(output.native());
+    fsb::io::fd_buffer buffer(output_fd.get(), 16);
+    std::ostream stream(&buffer);
+    // Small writes are buffered, and large ones bypass the buffer.
+    stream << "abc" << large << 'd' << "0123456789abcdef";
+    stream.flush();
+    ASSERT_TRUE(stream.good());
+  }
+  
+  ASSERT_EQ("abc" + large + "d0123456789abcdef", read_file(output));
+  
+  boost::filesystem::remove(output);
+}
+
+}
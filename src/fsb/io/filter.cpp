@@ -12,7 +12,8 @@
 //
 #include "fsb/io/filter.hpp"
 
-#include <glog/logging.h>
+#include "fsb/error.hpp"
+#include "fsb/stats.hpp"
 
 namespace fsb { namespace io {
 
@@ -20,7 +21,8 @@ bool reverse_bits_filter_impl::filter(
   const char * &src_begin, const char * src_end,
   char * &dst_begin, char * dst_end,
   bool /* flush */) {
-    
+  
+  stats::scoped_timer timer(stats::stage::decrypt);
   while (src_begin != src_end && dst_begin != dst_end) {
     *reinterpret_cast<std::uint8_t*>(dst_begin++) = 
       reverse_bits(*reinterpret_cast<const std::uint8_t*>(src_begin++));
@@ -36,10 +38,13 @@ reverse_bits_filter::reverse_bits_filter()
   : boost::iostreams::symmetric_filter<reverse_bits_filter_impl>(1024) {
 }
 
-xor_filter_impl::xor_filter_impl(boost::string_ref key)
+xor_filter_impl::xor_filter_impl(boost::string_ref key, std::uint64_t offset)
   : key_(key)
-  , key_position_(key_.data()) {
-  CHECK(!key_.empty());
+  , key_start_(key_.data() + (key_.empty() ? 0 : offset % key_.size()))
+  , key_position_(key_start_) {
+  if (key_.empty()) {
+    throw error("Empty key.");
+  }
 }
 
 bool xor_filter_impl::filter(
@@ -47,6 +52,7 @@ bool xor_filter_impl::filter(
   char * &dst_begin, char * dst_end,
   bool /* flush */) {
 
+  stats::scoped_timer timer(stats::stage::decrypt);
   const char * key_begin = key_.data();
   const char * key_end = key_.data() + key_.size();
 
@@ -61,11 +67,28 @@ bool xor_filter_impl::filter(
 }
 
 void xor_filter_impl::close() {
-  key_position_ = key_.data();
+  key_position_ = key_start_;
+}
+
+xor_filter::xor_filter(boost::string_ref key, std::uint64_t offset)
+  : boost::iostreams::symmetric_filter<xor_filter_impl>(1024, key, offset) {
 }
 
-xor_filter::xor_filter(boost::string_ref key)
-  : boost::iostreams::symmetric_filter<xor_filter_impl>(1024, key) {
+void decrypt(
+  boost::string_ref key, std::uint64_t offset, char * data, std::size_t size) {
+  if (key.empty()) {
+    throw error("Empty key.");
+  }
+  stats::scoped_timer timer(stats::stage::decrypt);
+  std::size_t key_position = offset % key.size();
+  for (std::size_t i = 0; i != size; ++i) {
+    data[i] = static_cast<char>(
+      reverse_bits(static_cast<std::uint8_t>(data[i])) ^ 
+      static_cast<std::uint8_t>(key[key_position]));
+    if (++key_position == key.size()) {
+      key_position = 0;
+    }
+  }
 }
 
 }}
@@ -16,6 +16,7 @@
 #include <boost/iostreams/filter/symmetric.hpp>
 #include <boost/utility/string_ref.hpp>
 
+#include <cstddef>
 #include <cstdint>
 
 namespace fsb { namespace io {
@@ -57,8 +58,10 @@ public:
   // Type of processed characters.
   typedef char char_type;
   
-  // Constructs filter with a given non-empty key.
-  xor_filter_impl(boost::string_ref key);
+  // Constructs filter with a given non-empty key. Offset is the position of
+  // the first filtered byte within the stream, it determines the first key
+  // character used.
+  xor_filter_impl(boost::string_ref key, std::uint64_t offset = 0);
   
   bool filter(
     const char * &src_begin, const char * src_end,
@@ -68,15 +71,22 @@ public:
   void close();
 private:
   const std::string key_;
+  const char * const key_start_;
   const char * key_position_;
 };
 
 struct xor_filter
   : boost::iostreams::symmetric_filter<xor_filter_impl> {
-  // Constructs filter with a given non-empty key.
-  xor_filter(boost::string_ref key);
+  // Constructs filter with a given non-empty key, starting at given offset
+  // within the stream.
+  xor_filter(boost::string_ref key, std::uint64_t offset = 0);
 };
 
+// Decrypts data in place. Result is the same as reading data through a 
+// reverse_bits_filter and an xor_filter with given non-empty key and offset.
+void decrypt(
+  boost::string_ref key, std::uint64_t offset, char * data, std::size_t size);
+
 }}
 
 #endif
@@ -11,11 +11,17 @@
 // GNU General Public License for more details.
 //
 #include "fsb/io/filter.hpp"
+#include "fsb/stats.hpp"
+#include "fsb/test_support.hpp"
 
+#include <boost/iostreams/device/array.hpp>
 #include <boost/iostreams/device/back_inserter.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
 #include <gtest/gtest.h>
 
+#include <iterator>
+#include <string>
+
 using namespace fsb::io;
 namespace io = boost::iostreams;
 
@@ -90,4 +96,68 @@ TEST(xor_filter_test, filtering_twice_is_identity) {
   ASSERT_EQ(input, xored_twice);
 }
 
+TEST(xor_filter_test, filtering_from_offset) {
+  const std::string key { "key" };
+  const std::string input { "message text" };
+  
+  std::string whole;
+  {
+    io::filtering_ostream out;
+    out.push(xor_filter(key));
+    out.push(io::back_inserter(whole));
+    out << input;
+    out.flush();
+  }
+  
+  std::string suffix;
+  {
+    io::filtering_ostream out;
+    out.push(xor_filter(key, 5));
+    out.push(io::back_inserter(suffix));
+    out << input.substr(5);
+    out.flush();
+  }
+  
+  ASSERT_EQ(whole.substr(5), suffix);
+}
+
+TEST(decrypt_test, same_as_filters) {
+  const std::string key { "key" };
+  const std::string input { "encrypted message text" };
+  
+  std::string filtered;
+  {
+    io::filtering_istream in;
+    in.push(xor_filter(key, 5));
+    in.push(reverse_bits_filter());
+    in.push(io::array_source(input.data() + 5, input.size() - 5));
+    filtered.assign(
+      std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  
+  std::string decrypted = input.substr(5);
+  decrypt(key, 5, &decrypted[0], decrypted.size());
+  ASSERT_EQ(filtered, decrypted);
+}
+
+TEST(xor_filter_test, time_is_attributed_to_decrypt_stage) {
+  fsb::test::scoped_enable enable(
+    fsb::stats::enabled, fsb::stats::enable, fsb::stats::disable);
+  const int decrypt = static_cast<int>(fsb::stats::stage::decrypt);
+  const fsb::stats::snapshot before = fsb::stats::collect();
+  {
+    fsb::stats::scoped_timer timer(fsb::stats::stage::read);
+    std::string output;
+    io::filtering_ostream out;
+    out.push(xor_filter("key"));
+    out.push(reverse_bits_filter());
+    out.push(io::back_inserter(output));
+    out << std::string(16 << 20, 'x');
+    out.flush();
+  }
+  const fsb::stats::snapshot after = fsb::stats::collect();
+  
+  ASSERT_LT(before.stages[decrypt], after.stages[decrypt]);
+}
+
 }
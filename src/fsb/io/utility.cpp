@@ -12,7 +12,7 @@
 //
 #include "fsb/io/utility.hpp"
 
-#include <glog/logging.h>
+#include "fsb/error.hpp"
 
 #include <istream>
 #include <limits>
@@ -25,7 +25,10 @@ void read(std::istream & stream, char * buffer, std::size_t size) {
   while (size > 0) {
     const std::streamsize to_read = streamsize_max < size ?
       streamsize_max : size;
-    CHECK(stream.read(buffer, to_read));
+    if (!stream.read(buffer, to_read)) {
+      throw error("Unexpected end of stream.");
+    }
+    buffer += to_read;
     size -= to_read;
   }
 }
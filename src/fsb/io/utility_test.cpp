@@ -12,6 +12,8 @@
 //
 #include "fsb/io/utility.hpp"
 
+#include "fsb/error.hpp"
+
 #include <gtest/gtest.h>
 
 #include <sstream>
@@ -30,7 +32,7 @@ TEST(read_test, unsuccesfull_read) {
   std::istringstream in { "12" };
   char buffer[4];
   
-  ASSERT_DEATH(fsb::io::read(in, buffer, 4), "");
+  ASSERT_THROW(fsb::io::read(in, buffer, 4), fsb::error);
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,113 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/io/wav.hpp"
+
+#include "fsb/error.hpp"
+
+#include <limits>
+#include <ostream>
+
+namespace fsb { namespace io {
+
+namespace {
+
+const std::uint32_t fmt_chunk_size = 16;
+const std::uint32_t smpl_chunk_size = 60;
+
+void write_uint16(std::ostream & stream, std::uint16_t x) {
+  const char bytes[] {
+    static_cast<char>(x),
+    static_cast<char>(x >> 8u)};
+  stream.write(bytes, sizeof(bytes));
+}
+
+void write_uint32(std::ostream & stream, std::uint32_t x) {
+  const char bytes[] {
+    static_cast<char>(x),
+    static_cast<char>(x >> 8u),
+    static_cast<char>(x >> 16u),
+    static_cast<char>(x >> 24u)};
+  stream.write(bytes, sizeof(bytes));
+}
+
+void write_chunk_header(
+  std::ostream & stream, const char * id, std::uint32_t size) {
+  stream.write(id, 4);
+  write_uint32(stream, size);
+}
+
+}
+
+std::uint32_t wav_header_size(std::uint32_t loop_end) {
+  return 12 + 8 + fmt_chunk_size + (loop_end ? 8 + smpl_chunk_size : 0) + 8;
+}
+
+void write_wav_header(
+  std::ostream & stream,
+  const wav_format & format,
+  std::uint64_t data_size,
+  std::uint32_t loop_start,
+  std::uint32_t loop_end) {
+  
+  const std::uint16_t block_align = 
+    format.channels * (format.bits_per_sample / 8u);
+  if (block_align == 0) {
+    throw error("Invalid WAV format.");
+  }
+  
+  // Chunks must have even size, data chunk is padded if necessary.
+  const std::uint64_t riff_size = 
+    wav_header_size(loop_end) - 8 + data_size + (data_size & 1u);
+  if (riff_size > std::numeric_limits<std::uint32_t>::max()) {
+    throw error("Data is too large for WAV file.");
+  }
+  write_chunk_header(stream, "RIFF", static_cast<std::uint32_t>(riff_size));
+  stream.write("WAVE", 4);
+  
+  write_chunk_header(stream, "fmt ", fmt_chunk_size);
+  write_uint16(stream, format.format_tag);
+  write_uint16(stream, format.channels);
+  write_uint32(stream, format.rate);
+  write_uint32(stream, format.rate * block_align);
+  write_uint16(stream, block_align);
+  write_uint16(stream, format.bits_per_sample);
+  
+  if (loop_end) {
+    write_chunk_header(stream, "smpl", smpl_chunk_size);
+    // Manufacturer and product.
+    write_uint32(stream, 0);
+    write_uint32(stream, 0);
+    // Sample period in nanoseconds.
+    write_uint32(stream, format.rate ? 1000000000u / format.rate : 0);
+    // MIDI unity note and pitch fraction.
+    write_uint32(stream, 60);
+    write_uint32(stream, 0);
+    // SMPTE format and offset.
+    write_uint32(stream, 0);
+    write_uint32(stream, 0);
+    // Number of loops and size of sampler data.
+    write_uint32(stream, 1);
+    write_uint32(stream, 0);
+    // Loop identifier, type (forward), start, end, fraction and play count.
+    write_uint32(stream, 0);
+    write_uint32(stream, 0);
+    write_uint32(stream, loop_start);
+    write_uint32(stream, loop_end);
+    write_uint32(stream, 0);
+    write_uint32(stream, 0);
+  }
+  
+  write_chunk_header(stream, "data", static_cast<std::uint32_t>(data_size));
+}
+
+}}
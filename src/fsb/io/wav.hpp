@@ -0,0 +1,47 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_IO_WAV_HPP
+#define FSB_IO_WAV_HPP
+
+#include <cstdint>
+#include <iosfwd>
+
+namespace fsb { namespace io {
+
+// Format of audio data in WAV file.
+struct wav_format {
+  // Format tag, 1 for integer PCM, 3 for floating point PCM.
+  std::uint16_t format_tag = 1;
+  std::uint16_t channels = 0;
+  std::uint32_t rate = 0;
+  std::uint16_t bits_per_sample = 0;
+};
+
+// Writes headers of WAV file with data chunk of given size. Data itself should
+// be written right after the headers.
+//
+// If loop end is non-zero, a sampler chunk describing the loop is included.
+// Throws error if data is too large for sizes of RIFF chunks.
+void write_wav_header(
+  std::ostream & stream,
+  const wav_format & format,
+  std::uint64_t data_size,
+  std::uint32_t loop_start = 0,
+  std::uint32_t loop_end = 0);
+
+// Returns size of WAV headers written by write_wav_header.
+std::uint32_t wav_header_size(std::uint32_t loop_end);
+
+}}
+
+#endif
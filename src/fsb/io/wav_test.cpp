@@ -0,0 +1,91 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/io/wav.hpp"
+
+#include "fsb/error.hpp"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+namespace {
+
+std::uint32_t get_uint32(const std::string & s, std::size_t offset) {
+  return 
+    std::uint32_t(std::uint8_t(s[offset + 0])) << 0u |
+    std::uint32_t(std::uint8_t(s[offset + 1])) << 8u |
+    std::uint32_t(std::uint8_t(s[offset + 2])) << 16u |
+    std::uint32_t(std::uint8_t(s[offset + 3])) << 24u;
+}
+
+TEST(wav_test, header_without_loop) {
+  fsb::io::wav_format format;
+  format.channels = 2;
+  format.rate = 44100;
+  format.bits_per_sample = 16;
+  
+  std::ostringstream os;
+  fsb::io::write_wav_header(os, format, 400);
+  const std::string header = os.str();
+  
+  ASSERT_EQ(44u, header.size());
+  ASSERT_EQ(fsb::io::wav_header_size(0), header.size());
+  ASSERT_EQ("RIFF", header.substr(0, 4));
+  ASSERT_EQ(36u + 400u, get_uint32(header, 4));
+  ASSERT_EQ("WAVE", header.substr(8, 4));
+  ASSERT_EQ("fmt ", header.substr(12, 4));
+  ASSERT_EQ(44100u, get_uint32(header, 24));
+  // Byte rate.
+  ASSERT_EQ(44100u * 4u, get_uint32(header, 28));
+  ASSERT_EQ("data", header.substr(36, 4));
+  ASSERT_EQ(400u, get_uint32(header, 40));
+}
+
+TEST(wav_test, header_with_loop) {
+  fsb::io::wav_format format;
+  format.channels = 1;
+  format.rate = 22050;
+  format.bits_per_sample = 16;
+  
+  std::ostringstream os;
+  fsb::io::write_wav_header(os, format, 101, 10, 20);
+  const std::string header = os.str();
+  
+  ASSERT_EQ(fsb::io::wav_header_size(20), header.size());
+  // Odd sized data chunk is padded.
+  ASSERT_EQ(header.size() - 8 + 102, get_uint32(header, 4));
+  ASSERT_EQ("smpl", header.substr(36, 4));
+  ASSERT_EQ(10u, get_uint32(header, 44 + 44));
+  ASSERT_EQ(20u, get_uint32(header, 44 + 48));
+  ASSERT_EQ("data", header.substr(header.size() - 8, 4));
+}
+
+TEST(wav_test, data_too_large) {
+  fsb::io::wav_format format;
+  format.channels = 2;
+  format.rate = 44100;
+  format.bits_per_sample = 16;
+  
+  std::ostringstream os;
+  ASSERT_THROW(
+    fsb::io::write_wav_header(os, format, std::uint64_t(1) << 32), 
+    fsb::error);
+  // Largest data that fits together with headers.
+  const std::uint64_t max_size = 
+    0xffffffffu - (fsb::io::wav_header_size(0) - 8) - 1;
+  fsb::io::write_wav_header(os, format, max_size);
+  ASSERT_THROW(
+    fsb::io::write_wav_header(os, format, max_size + 2), fsb::error);
+}
+
+}
@@ -0,0 +1,96 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/job_list.hpp"
+
+#include "fsb/error.hpp"
+
+#include <algorithm>
+#include <istream>
+#include <tuple>
+#include <utility>
+
+#include <sys/stat.h>
+
+namespace fsb {
+
+std::vector<job_entry> read_job_list(std::istream & stream) {
+  std::vector<job_entry> entries;
+  std::string line;
+  while (std::getline(stream, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    
+    std::vector<std::string> fields;
+    std::string::size_type begin = 0;
+    for (;;) {
+      const std::string::size_type end = line.find('\t', begin);
+      fields.push_back(line.substr(begin, end - begin));
+      if (end == std::string::npos) {
+        break;
+      }
+      begin = end + 1;
+    }
+    if (fields[0].empty()) {
+      throw error("Job list entry without container path: " + line);
+    }
+    
+    job_entry entry;
+    entry.path = std::move(fields[0]);
+    if (fields.size() > 1) {
+      entry.destination = std::move(fields[1]);
+    }
+    for (std::size_t i = 2; i < fields.size(); ++i) {
+      if (!fields[i].empty()) {
+        entry.samples.push_back(std::move(fields[i]));
+      }
+    }
+    entries.push_back(std::move(entry));
+  }
+  if (stream.bad()) {
+    throw error("Failed to read job list.");
+  }
+  return entries;
+}
+
+void sort_for_sequential_io(std::vector<job_entry> & entries) {
+  // Missing files get the largest key, stable sort keeps their order.
+  typedef std::tuple<bool, dev_t, ino_t> key_type;
+  std::vector<std::pair<key_type, std::size_t>> keys;
+  keys.reserve(entries.size());
+  for (std::size_t i = 0; i != entries.size(); ++i) {
+    struct stat status;
+    if (::stat(entries[i].path.c_str(), &status) == 0) {
+      keys.emplace_back(key_type(false, status.st_dev, status.st_ino), i);
+    } else {
+      keys.emplace_back(key_type(true, 0, 0), i);
+    }
+  }
+  std::stable_sort(keys.begin(), keys.end(), 
+    [](const std::pair<key_type, std::size_t> & a,
+       const std::pair<key_type, std::size_t> & b) {
+      return a.first < b.first;
+    });
+  
+  std::vector<job_entry> sorted;
+  sorted.reserve(entries.size());
+  for (const auto & key : keys) {
+    sorted.push_back(std::move(entries[key.second]));
+  }
+  entries.swap(sorted);
+}
+
+}
@@ -0,0 +1,43 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_JOB_LIST_HPP
+#define FSB_JOB_LIST_HPP
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace fsb {
+
+// Container to process, together with its own extraction settings.
+struct job_entry {
+  std::string path;
+  // Destination directory, empty to use the default one.
+  std::string destination;
+  // Names of samples to extract, empty to extract all of them.
+  std::vector<std::string> samples;
+};
+
+// Reads job list. Each line contains tab separated path of a container, 
+// optionally followed by destination directory and names of samples to 
+// extract. Empty lines and lines starting with '#' are ignored.
+std::vector<job_entry> read_job_list(std::istream & stream);
+
+// Orders entries by device and inode number of their files, which 
+// approximates their placement on disk, so that they are read mostly 
+// sequentially. Files that cannot be found are kept last in original order.
+void sort_for_sequential_io(std::vector<job_entry> & entries);
+
+}
+
+#endif
@@ -0,0 +1,92 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/job_list.hpp"
+#include "fsb/error.hpp"
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <sstream>
+
+#include <sys/stat.h>
+
+using namespace fsb;
+
+namespace {
+
+TEST(job_list_test, read_job_list) {
+  std::istringstream stream(
+    "# comment\n"
+    "a.fsb\n"
+    "\n"
+    "b b.fsb\tout dir\r\n"
+    "c.fsb\t\tfirst\tsecond sample\n");
+  const std::vector<job_entry> entries = read_job_list(stream);
+  ASSERT_EQ(3u, entries.size());
+  
+  ASSERT_EQ("a.fsb", entries[0].path);
+  ASSERT_EQ("", entries[0].destination);
+  ASSERT_TRUE(entries[0].samples.empty());
+  
+  ASSERT_EQ("b b.fsb", entries[1].path);
+  ASSERT_EQ("out dir", entries[1].destination);
+  ASSERT_TRUE(entries[1].samples.empty());
+  
+  ASSERT_EQ("c.fsb", entries[2].path);
+  ASSERT_EQ("", entries[2].destination);
+  ASSERT_EQ(
+    (std::vector<std::string> {"first", "second sample"}), 
+    entries[2].samples);
+}
+
+TEST(job_list_test, read_malformed_job_list) {
+  std::istringstream stream("\tdestination\n");
+  ASSERT_THROW(read_job_list(stream), error);
+}
+
+TEST(job_list_test, missing_files_are_sorted_last) {
+  const boost::filesystem::path directory = 
+    boost::filesystem::temp_directory_path() / 
+    boost::filesystem::unique_path();
+  boost::filesystem::create_directories(directory);
+  
+  std::vector<job_entry> entries(5);
+  entries[0].path = (directory / "missing-1").native();
+  entries[1].path = (directory / "a").native();
+  entries[2].path = (directory / "missing-2").native();
+  entries[3].path = (directory / "b").native();
+  entries[4].path = (directory / "c").native();
+  for (const auto & entry : {entries[1], entries[3], entries[4]}) {
+    std::ofstream stream(entry.path);
+  }
+  
+  std::vector<job_entry> sorted = entries;
+  sort_for_sequential_io(sorted);
+  ASSERT_EQ(5u, sorted.size());
+  ASSERT_EQ(entries[0].path, sorted[3].path);
+  ASSERT_EQ(entries[2].path, sorted[4].path);
+  
+  // Existing files are ordered by inode number.
+  const auto inode = [](const job_entry & entry) {
+    struct stat status;
+    EXPECT_EQ(0, ::stat(entry.path.c_str(), &status));
+    return status.st_ino;
+  };
+  ASSERT_LE(inode(sorted[0]), inode(sorted[1]));
+  ASSERT_LE(inode(sorted[1]), inode(sorted[2]));
+  
+  boost::filesystem::remove_all(directory);
+}
+
+}
@@ -0,0 +1,229 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/key_recovery.hpp"
+
+#include "fsb/container.hpp"
+#include "fsb/error.hpp"
+#include "fsb/io/filter.hpp"
+
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
+
+#include <algorithm>
+#include <array>
+
+namespace fsb {
+
+namespace {
+
+const std::size_t header_size = 60;
+// Sizes of regions after file header, that are analysed before sizes of 
+// headers are known. Small regions suit containers with few samples, where 
+// sample data would outweigh the headers.
+const std::size_t initial_region_sizes[] = {256, 1024, 4096, 16384, 65536};
+
+// Decrypts a byte, like decryption filters do.
+std::uint8_t decrypt(std::uint8_t byte, std::uint8_t key) {
+  return io::reverse_bits(byte) ^ key;
+}
+
+// Scores of each password byte value, for every password position.
+typedef std::vector<std::array<std::int64_t, 256>> score_table;
+
+// Returns score of a plaintext byte at given position of file header. Fields
+// with known values get certain score, or its negation if they do not match.
+std::int64_t header_score(std::size_t position, std::uint8_t plain) {
+  // Outweighs any number of bytes in analysed regions.
+  const std::int64_t certain = std::int64_t(1) << 40;
+  // Bonus for high bytes of sample count and section sizes being zero.
+  const std::int64_t probable = 8;
+  switch (position) {
+    case 0: case 1: case 2: case 3:
+      return plain == std::uint8_t("FSB5"[position]) ? certain : -certain;
+    case 4:
+      return plain == 1 ? certain : -certain;
+    case 5: case 6: case 7:
+    case 25: case 26: case 27:
+      return plain == 0 ? certain : -certain;
+    case 24:
+      return 0 < plain && plain < std::uint8_t(format::max) ? 
+        certain : -certain;
+    case 10: case 11: case 14: case 15: case 18: case 19: case 23:
+      return plain == 0 ? probable : 0;
+    default:
+      return 0;
+  }
+}
+
+// Returns scores of passwords of given length, based on file header alone.
+score_table header_scores(const std::uint8_t * data, std::size_t length) {
+  score_table scores(length);
+  for (auto & column : scores) {
+    column.fill(0);
+  }
+  for (std::size_t position = 0; position < header_size; ++position) {
+    auto & column = scores[position % length];
+    for (int key = 0; key < 256; ++key) {
+      column[key] += header_score(position, decrypt(data[position], key));
+    }
+  }
+  return scores;
+}
+
+// Chooses password that best explains bytes in the file header, and the 
+// assumption that bytes in a given region decrypt to zero. Returns empty 
+// string if known header fields cannot be all satisfied.
+std::string derive_password(
+  const std::uint8_t * data, score_table scores,
+  std::size_t region_begin, std::size_t region_end) {
+  const std::size_t length = scores.size();
+  
+  // Plaintext is zero exactly when password byte equals encrypted byte with
+  // reversed bits.
+  for (std::size_t i = region_begin; i < region_end; ++i) {
+    scores[i % length][io::reverse_bits(data[i])] += 1;
+  }
+  
+  std::string password(length, '\0');
+  for (std::size_t i = 0; i < length; ++i) {
+    const auto best = std::max_element(scores[i].begin(), scores[i].end());
+    if (*best < 0) {
+      return std::string();
+    }
+    password[i] = static_cast<char>(best - scores[i].begin());
+  }
+  return password;
+}
+
+// Decrypts little endian 32-bit integer at given position.
+std::uint32_t decrypt_uint32(
+  const std::uint8_t * data, std::size_t position, 
+  const std::string & password) {
+  std::uint32_t value = 0;
+  for (std::size_t i = 0; i < 4; ++i) {
+    const std::uint8_t key = password[(position + i) % password.size()];
+    value |= std::uint32_t(decrypt(data[position + i], key)) << (8 * i);
+  }
+  return value;
+}
+
+// Returns true if password decrypts headers of a valid container.
+bool is_valid(
+  boost::string_ref prefix, std::uint64_t size, const std::string & password) {
+  const std::uint8_t * const data = 
+    reinterpret_cast<const std::uint8_t *>(prefix.data());
+  const std::uint64_t headers_size = decrypt_uint32(data, 12, password);
+  const std::uint64_t names_size = decrypt_uint32(data, 16, password);
+  const std::uint64_t data_size = decrypt_uint32(data, 20, password);
+  // Avoids reading sections that are not there.
+  if (header_size + headers_size + names_size > prefix.size() ||
+      header_size + headers_size + names_size + data_size > size) {
+    return false;
+  }
+  
+  try {
+    boost::iostreams::stream<boost::iostreams::array_source> stream(
+      prefix.data(), prefix.size());
+    // Container checks that names are terminated within the names table, and
+    // that sample offsets increase within the data section.
+    const container container(stream, password, false);
+    for (const auto & sample : container.samples()) {
+      // Names are not necessarily ASCII, but never contain control 
+      // characters.
+      for (const char c : sample.name) {
+        const unsigned char byte = static_cast<unsigned char>(c);
+        if (byte < 0x20 || byte == 0x7f) {
+          return false;
+        }
+      }
+    }
+    return true;
+  } catch (const error &) {
+    return false;
+  }
+}
+
+// Returns true if password is a repetition of another one.
+bool is_repetition(const std::string & password, const std::string & base) {
+  if (password.size() % base.size() != 0) {
+    return false;
+  }
+  for (std::size_t i = 0; i < password.size(); ++i) {
+    if (password[i] != base[i % base.size()]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}
+
+std::vector<std::string> recover_password(
+  boost::string_ref prefix, std::uint64_t size, std::size_t max_length) {
+  std::vector<std::string> passwords;
+  if (prefix.size() < header_size) {
+    return passwords;
+  }
+  
+  const std::uint8_t * const data = 
+    reinterpret_cast<const std::uint8_t *>(prefix.data());
+  
+  for (std::size_t length = 1; length <= max_length; ++length) {
+    const score_table scores = header_scores(data, length);
+    std::vector<std::string> candidates;
+    for (const std::size_t region_size : initial_region_sizes) {
+      const std::size_t region_end = 
+        std::min<std::size_t>(prefix.size(), header_size + region_size);
+      const std::string initial = 
+        derive_password(data, scores, header_size, region_end);
+      if (initial.empty()) {
+        // Known header fields are contradictory for this length.
+        break;
+      }
+      
+      // Once sizes of headers are known, exactly the headers are analysed.
+      const std::uint64_t headers_end = header_size +
+        std::uint64_t(decrypt_uint32(data, 12, initial)) + 
+        decrypt_uint32(data, 16, initial);
+      if (headers_end <= prefix.size()) {
+        candidates.push_back(
+          derive_password(data, scores, header_size, headers_end));
+      }
+      candidates.push_back(initial);
+      if (region_end == prefix.size()) {
+        break;
+      }
+    }
+    
+    for (std::size_t i = 0; i < candidates.size(); ++i) {
+      const std::string & candidate = candidates[i];
+      const bool tried = std::find(
+        candidates.begin(), candidates.begin() + i, candidate) != 
+        candidates.begin() + i;
+      if (tried || !is_valid(prefix, size, candidate)) {
+        continue;
+      }
+      const bool repeated = std::any_of(passwords.begin(), passwords.end(),
+        [&](const std::string & password) {
+          return is_repetition(candidate, password);
+        });
+      if (!repeated) {
+        passwords.push_back(candidate);
+      }
+      break;
+    }
+  }
+  return passwords;
+}
+
+}
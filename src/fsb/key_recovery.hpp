@@ -0,0 +1,42 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_KEY_RECOVERY_HPP
+#define FSB_KEY_RECOVERY_HPP
+
+#include <boost/utility/string_ref.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fsb {
+
+// Recovers password of an encrypted container from its headers alone.
+//
+// Container is encrypted by xor-ing it with a repeated password and reversing
+// bits of each byte. For each password length, every password byte is chosen
+// so that known fields of the file header decrypt to their expected values,
+// and that most of the remaining header bytes, which are usually zero, 
+// decrypt to zero. Candidates are then validated by parsing sample headers 
+// and names.
+//
+// Prefix of container should include all headers, size is the size of the
+// whole container. Returns passwords found, shortest first, omitting 
+// repetitions of shorter ones.
+std::vector<std::string> recover_password(
+  boost::string_ref prefix, std::uint64_t size, std::size_t max_length = 32);
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/key_recovery.hpp"
+
+#include "fsb/bench/synthetic.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace fsb;
+
+namespace {
+
+std::vector<std::string> recover(
+  const std::string & password, 
+  const std::string & name_prefix = "sample_") {
+  bench::synthetic_options options;
+  options.samples = 16;
+  options.sample_size = 4000;
+  options.password = password;
+  options.name_prefix = name_prefix;
+  const std::vector<char> buffer = bench::make_synthetic_container(options);
+  return recover_password(
+    boost::string_ref(buffer.data(), buffer.size()), buffer.size());
+}
+
+TEST(key_recovery_test, recovers_password) {
+  ASSERT_EQ(std::vector<std::string> {"x"}, recover("x"));
+  ASSERT_EQ(std::vector<std::string> {"secret"}, recover("secret"));
+  ASSERT_EQ(
+    std::vector<std::string> {"DFm3t4lFTW+key"}, recover("DFm3t4lFTW+key"));
+}
+
+TEST(key_recovery_test, names_may_be_utf8) {
+  ASSERT_EQ(
+    std::vector<std::string> {"secret"}, 
+    recover("secret", "\xd0\xb7\xd0\xb2\xd1\x83\xd0\xba_"));
+}
+
+TEST(key_recovery_test, nothing_is_found_in_garbage) {
+  std::string garbage(4096, '\0');
+  for (std::size_t i = 0; i < garbage.size(); ++i) {
+    garbage[i] = static_cast<char>(i * 7919 % 251);
+  }
+  ASSERT_TRUE(recover_password(garbage, garbage.size()).empty());
+  ASSERT_TRUE(recover_password("FSB5", 4).empty());
+}
+
+}
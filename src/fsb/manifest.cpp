@@ -0,0 +1,174 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/manifest.hpp"
+
+#include "fsb/error.hpp"
+
+#include <boost/crc.hpp>
+
+#include <iomanip>
+#include <istream>
+#include <ostream>
+#include <sstream>
+
+namespace fsb {
+
+namespace {
+
+const char magic[] = "fsb-manifest";
+const int version = 2;
+// Written in place of empty fields, that would break the line apart.
+const char empty_field[] = "-";
+
+}
+
+// Manifest is a text file with a following structure:
+//
+//   fsb-manifest 2
+//   container <size> <mtime> <guid> <samples> <path>
+//   destination <destination>
+//   sample <offset> <size> <crc32> <output>
+//   ...
+//
+// Each container line is followed by a destination line and exactly 
+// <samples> sample lines. Paths extend until the end of line, so they may 
+// contain spaces. Version 1 has neither destination nor outputs.
+void manifest::read(std::istream & stream) {
+  containers_.clear();
+  
+  std::string line;
+  if (!std::getline(stream, line)) {
+    // Empty manifest.
+    return;
+  }
+  
+  std::istringstream preamble(line);
+  std::string preamble_magic;
+  int preamble_version = 0;
+  preamble >> preamble_magic >> preamble_version;
+  if (preamble_magic != magic || 
+      preamble_version < 1 || preamble_version > version) {
+    throw error("Unsupported manifest format: " + line);
+  }
+  
+  while (std::getline(stream, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    std::istringstream container_line(line);
+    std::string kind;
+    container_entry entry;
+    std::size_t samples = 0;
+    container_line 
+      >> kind >> entry.size >> entry.mtime >> entry.guid >> samples;
+    if (!container_line || kind != "container") {
+      throw error("Malformed manifest line: " + line);
+    }
+    if (entry.guid == empty_field) {
+      entry.guid.clear();
+    }
+    container_line.ignore(1);
+    std::string path;
+    std::getline(container_line, path);
+    if (path.empty()) {
+      throw error("Malformed manifest line: " + line);
+    }
+    
+    if (preamble_version >= 2) {
+      if (!std::getline(stream, line)) {
+        throw error("Truncated manifest.");
+      }
+      std::istringstream destination_line(line);
+      destination_line >> kind;
+      if (!destination_line || kind != "destination") {
+        throw error("Malformed manifest line: " + line);
+      }
+      destination_line.ignore(1);
+      std::getline(destination_line, entry.destination);
+    }
+    
+    entry.samples.resize(samples);
+    for (auto & sample : entry.samples) {
+      if (!std::getline(stream, line)) {
+        throw error("Truncated manifest.");
+      }
+      std::istringstream sample_line(line);
+      sample_line >> kind >> sample.offset >> sample.size >> sample.crc32;
+      if (!sample_line || kind != "sample") {
+        throw error("Malformed manifest line: " + line);
+      }
+      if (preamble_version >= 2) {
+        sample_line.ignore(1);
+        std::getline(sample_line, sample.output);
+      }
+    }
+    
+    containers_[path] = std::move(entry);
+  }
+}
+
+void manifest::write(std::ostream & stream) const {
+  stream << magic << ' ' << version << '\n';
+  for (const auto & container : containers_) {
+    const container_entry & entry = container.second;
+    stream
+      << "container "
+      << entry.size << ' '
+      << entry.mtime << ' '
+      << (entry.guid.empty() ? empty_field : entry.guid) << ' '
+      << entry.samples.size() << ' '
+      << container.first << '\n'
+      << "destination " << entry.destination << '\n';
+    for (const auto & sample : entry.samples) {
+      stream
+        << "sample "
+        << sample.offset << ' '
+        << sample.size << ' '
+        << sample.crc32 << ' '
+        << sample.output << '\n';
+    }
+  }
+}
+
+const manifest::container_entry * manifest::find(
+  const std::string & path) const {
+  const auto i = containers_.find(path);
+  return i != containers_.end() ? &i->second : nullptr;
+}
+
+void manifest::insert(const std::string & path, container_entry entry) {
+  containers_[path] = std::move(entry);
+}
+
+std::string manifest::guid_string(const header & header) {
+  std::ostringstream os;
+  os << std::hex << std::setfill('0');
+  for (const auto byte : header.guid) {
+    os << std::setw(2) << int(static_cast<std::uint8_t>(byte));
+  }
+  return os.str();
+}
+
+manifest::sample_entry manifest::make_sample_entry(
+  const sample & sample, io::buffer_view sample_view) {
+  boost::crc_32_type crc;
+  crc.process_bytes(sample_view.begin(), sample_view.size());
+  
+  sample_entry entry;
+  entry.offset = sample.offset;
+  entry.size = sample.size;
+  entry.crc32 = crc.checksum();
+  return entry;
+}
+
+}
@@ -0,0 +1,91 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_MANIFEST_HPP
+#define FSB_MANIFEST_HPP
+
+#include "fsb/fsb.hpp"
+#include "fsb/io/buffer_view.hpp"
+
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace fsb {
+
+// State of previous extraction runs, used to skip work that was already done.
+//
+// Containers are identified by their path. Container is considered unchanged 
+// if its size, modification time and header hash are the same. Samples are 
+// identified by their position within a container, and are considered 
+// unchanged if their offset, size and CRC-32 of data are the same.
+//
+// Destination directory and output files are recorded as well, so that 
+// containers whose outputs are gone can be extracted again.
+class manifest {
+public:
+  struct sample_entry {
+    std::size_t offset = 0;
+    std::size_t size = 0;
+    std::uint32_t crc32 = 0;
+    // Path of extracted file, empty if unknown. Not compared for equality.
+    std::string output;
+  };
+  
+  struct container_entry {
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;
+    // Hex encoded hash from the container header.
+    std::string guid;
+    // Directory where samples were extracted, empty if unknown.
+    std::string destination;
+    std::vector<sample_entry> samples;
+  };
+  
+  // Reads manifest from a stream, replacing current content.
+  void read(std::istream & stream);
+  
+  // Writes manifest to a stream.
+  void write(std::ostream & stream) const;
+  
+  // Returns entry for a container with given path or null if there is none.
+  const container_entry * find(const std::string & path) const;
+  
+  // Inserts or replaces entry for a container with given path.
+  void insert(const std::string & path, container_entry entry);
+  
+  // Returns hex encoded hash from the container header.
+  static std::string guid_string(const header & header);
+  
+  // Returns entry describing given sample and its data.
+  static sample_entry make_sample_entry(
+    const sample & sample, io::buffer_view sample_view);
+  
+private:
+  std::map<std::string, container_entry> containers_;
+};
+
+inline bool operator==(
+  const manifest::sample_entry & a, const manifest::sample_entry & b) {
+  return a.offset == b.offset && a.size == b.size && a.crc32 == b.crc32;
+}
+
+inline bool operator!=(
+  const manifest::sample_entry & a, const manifest::sample_entry & b) {
+  return !(a == b);
+}
+
+}
+
+#endif
@@ -0,0 +1,120 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/error.hpp"
+#include "fsb/manifest.hpp"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+using namespace fsb;
+
+namespace {
+
+TEST(manifest_test, write_and_read) {
+  manifest::container_entry entry;
+  entry.size = 1234;
+  entry.mtime = 1445000000;
+  entry.guid = "00ff10";
+  entry.destination = "/out dir";
+  entry.samples.resize(2);
+  entry.samples[0].offset = 0;
+  entry.samples[0].size = 96;
+  entry.samples[0].crc32 = 0xdeadbeef;
+  entry.samples[1].offset = 96;
+  entry.samples[1].size = 32;
+  entry.samples[1].crc32 = 42;
+  entry.samples[1].output = "/out dir/2.b c.ogg";
+  
+  manifest original;
+  original.insert("dir with spaces/bank.fsb", entry);
+  original.insert("empty.fsb", manifest::container_entry());
+  
+  std::stringstream stream;
+  original.write(stream);
+  manifest restored;
+  restored.read(stream);
+  
+  const manifest::container_entry * found = 
+    restored.find("dir with spaces/bank.fsb");
+  ASSERT_NE(nullptr, found);
+  ASSERT_EQ(entry.size, found->size);
+  ASSERT_EQ(entry.mtime, found->mtime);
+  ASSERT_EQ(entry.guid, found->guid);
+  ASSERT_EQ(entry.destination, found->destination);
+  ASSERT_EQ(2u, found->samples.size());
+  ASSERT_EQ(entry.samples[0], found->samples[0]);
+  ASSERT_EQ(entry.samples[1], found->samples[1]);
+  ASSERT_EQ("", found->samples[0].output);
+  ASSERT_EQ(entry.samples[1].output, found->samples[1].output);
+  
+  found = restored.find("empty.fsb");
+  ASSERT_NE(nullptr, found);
+  ASSERT_TRUE(found->samples.empty());
+  
+  ASSERT_EQ(nullptr, restored.find("missing.fsb"));
+}
+
+TEST(manifest_test, read_malformed) {
+  std::istringstream truncated(
+    "fsb-manifest 1\n"
+    "container 10 20 00 2 a.fsb\n"
+    "sample 0 32 1\n");
+  manifest manifest;
+  ASSERT_THROW(manifest.read(truncated), fsb::error);
+  
+  std::istringstream unsupported("fsb-manifest 3\n");
+  ASSERT_THROW(manifest.read(unsupported), fsb::error);
+}
+
+TEST(manifest_test, read_version_1) {
+  std::istringstream stream(
+    "fsb-manifest 1\n"
+    "container 10 20 00 1 a.fsb\n"
+    "sample 0 32 1\n");
+  manifest manifest;
+  manifest.read(stream);
+  
+  const manifest::container_entry * found = manifest.find("a.fsb");
+  ASSERT_NE(nullptr, found);
+  ASSERT_EQ("", found->destination);
+  ASSERT_EQ(1u, found->samples.size());
+  ASSERT_EQ(32u, found->samples[0].size);
+  ASSERT_EQ("", found->samples[0].output);
+}
+
+TEST(manifest_test, sample_entry_covers_data) {
+  const char data[] { 1, 2, 3, 4 };
+  sample sample;
+  sample.offset = 32;
+  sample.size = 4;
+  
+  const manifest::sample_entry a = 
+    manifest::make_sample_entry(sample, io::buffer_view(data, 4));
+  ASSERT_EQ(32u, a.offset);
+  ASSERT_EQ(4u, a.size);
+  
+  const char other_data[] { 1, 2, 3, 5 };
+  const manifest::sample_entry b =
+    manifest::make_sample_entry(sample, io::buffer_view(other_data, 4));
+  ASSERT_NE(a, b);
+}
+
+TEST(manifest_test, guid_string) {
+  header header {};
+  header.guid[0] = 0x01;
+  header.guid[1] = -1;
+  ASSERT_EQ("01ff" + std::string(44, '0'), manifest::guid_string(header));
+}
+
+}
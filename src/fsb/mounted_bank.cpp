@@ -0,0 +1,177 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/mounted_bank.hpp"
+
+#include "fsb/error.hpp"
+#include "fsb/io/buffer_view.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace fsb {
+
+mounted_bank::mounted_bank(
+  const std::string & path, 
+  const std::string & password,
+  std::size_t cached_segments)
+  : path_(path)
+  , cached_segments_(std::max<std::size_t>(1, cached_segments)) {
+  std::ifstream stream(path, std::ios_base::in | std::ios_base::binary);
+  if (!stream) {
+    throw error("Failed to open path: " + path);
+  }
+  container_.reset(new container(stream, password, false));
+  if (container_->file_header().mode != format::vorbis) {
+    throw error("Only Vorbis containers can be mounted: " + path);
+  }
+  
+  const auto & samples = container_->samples();
+  for (std::size_t i = 0; i < samples.size(); ++i) {
+    std::string name = 
+      std::to_string(i + 1) + "." + samples[i].name.to_string() + ".ogg";
+    std::replace(name.begin(), name.end(), '/', '_');
+    files_.emplace(name, i);
+    file_names_.push_back(std::move(name));
+  }
+  indices_.resize(samples.size());
+}
+
+long mounted_bank::find_file(const std::string & name) const {
+  const auto it = files_.find(name);
+  return it == files_.end() ? -1 : static_cast<long>(it->second);
+}
+
+std::uint64_t mounted_bank::file_size(std::size_t file) {
+  return index(file)->size;
+}
+
+std::size_t mounted_bank::read(
+  std::size_t file, std::uint64_t offset, char * buffer, std::size_t size) {
+  const std::shared_ptr<const file_index> index = this->index(file);
+  if (offset >= index->size) {
+    return 0;
+  }
+  size = static_cast<std::size_t>(std::min<std::uint64_t>(
+    size, index->size - offset));
+  
+  // Last segment that begins at or before the offset.
+  const auto & segments = index->segments;
+  std::size_t number = std::upper_bound(segments.begin(), segments.end(), 
+    offset, [](std::uint64_t offset, const vorbis::rebuilder::checkpoint & c) {
+      return offset < c.output_offset;
+    }) - segments.begin() - 1;
+  
+  std::size_t done = 0;
+  while (done < size) {
+    const std::shared_ptr<const std::string> content = 
+      segment(file, *index, number);
+    const std::size_t begin = static_cast<std::size_t>(
+      offset + done - segments[number].output_offset);
+    const std::size_t length = std::min(content->size() - begin, size - done);
+    std::copy_n(content->data() + begin, length, buffer + done);
+    done += length;
+    number += 1;
+  }
+  return done;
+}
+
+std::shared_ptr<const mounted_bank::file_index> mounted_bank::index(
+  std::size_t file) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (indices_.at(file)) {
+      return indices_[file];
+    }
+  }
+  
+  const std::shared_ptr<const std::vector<char>> data = sample_data(file);
+  std::shared_ptr<file_index> index(new file_index());
+  index->segments.emplace_back();
+  index->size = vorbis::thread_rebuilder().layout_segments(
+    container_->samples()[file], io::buffer_view(data->data(), data->size()),
+    segment_size, index->segments);
+  
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!indices_[file]) {
+    indices_[file] = index;
+  }
+  return indices_[file];
+}
+
+std::shared_ptr<const std::string> mounted_bank::segment(
+  std::size_t file, const file_index & index, std::size_t segment) {
+  const segment_key key(file, segment);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = segments_index_.find(key);
+    if (it != segments_index_.end()) {
+      segments_.splice(segments_.begin(), segments_, it->second);
+      return it->second->second;
+    }
+  }
+  
+  const std::shared_ptr<const std::vector<char>> data = sample_data(file);
+  std::ostringstream output;
+  vorbis::thread_rebuilder().rebuild_segment(container_->samples()[file],
+    io::buffer_view(data->data(), data->size()), segment_size, 
+    index.segments[segment], output);
+  const std::shared_ptr<const std::string> content(
+    new std::string(output.str()));
+  
+  const std::uint64_t end = segment + 1 < index.segments.size() ?
+    index.segments[segment + 1].output_offset : index.size;
+  if (content->size() != end - index.segments[segment].output_offset) {
+    throw error("Rebuilt segment has unexpected size.");
+  }
+  
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!segments_index_.count(key)) {
+    segments_.emplace_front(key, content);
+    segments_index_.emplace(key, segments_.begin());
+    if (segments_.size() > cached_segments_) {
+      segments_index_.erase(segments_.back().first);
+      segments_.pop_back();
+    }
+  }
+  return content;
+}
+
+std::shared_ptr<const std::vector<char>> mounted_bank::sample_data(
+  std::size_t file) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = samples_.begin(); it != samples_.end(); ++it) {
+      if (it->first == file) {
+        samples_.splice(samples_.begin(), samples_, it);
+        return it->second;
+      }
+    }
+  }
+  
+  std::ifstream stream(path_, std::ios_base::in | std::ios_base::binary);
+  if (!stream) {
+    throw error("Failed to open path: " + path_);
+  }
+  const std::shared_ptr<const std::vector<char>> data(new std::vector<char>(
+    container_->read_sample_data(stream, container_->samples()[file])));
+  
+  std::lock_guard<std::mutex> lock(mutex_);
+  samples_.emplace_front(file, data);
+  if (samples_.size() > cached_samples) {
+    samples_.pop_back();
+  }
+  return data;
+}
+
+}
@@ -0,0 +1,111 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_MOUNTED_BANK_HPP
+#define FSB_MOUNTED_BANK_HPP
+
+#include "fsb/container.hpp"
+#include "fsb/vorbis/rebuilder.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fsb {
+
+// Container presented as a set of files, one per sample, with content 
+// rebuilt lazily in segments covering the requested byte ranges.
+//
+// Only headers and names are read when bank is opened. Vorbis samples are
+// indexed on first use: their exact size and checkpoints from which 
+// rebuilding can be resumed are computed from sizes of packets, without 
+// muxing them into pages. Reads then rebuild only segments they cover. 
+// Recently used segments and sample data are cached. Thread safe.
+class mounted_bank {
+  mounted_bank(const mounted_bank &) = delete;
+  mounted_bank & operator=(const mounted_bank &) = delete;
+public:
+  // Opens container at given path.
+  mounted_bank(
+    const std::string & path, 
+    const std::string & password,
+    std::size_t cached_segments = 64);
+  
+  // Returns names of files in order of samples.
+  const std::vector<std::string> & file_names() const {
+    return file_names_;
+  }
+  
+  // Returns index of file with given name, or -1 if there is none.
+  long find_file(const std::string & name) const;
+  
+  // Returns size of file with given index.
+  std::uint64_t file_size(std::size_t file);
+  
+  // Reads up to size bytes of a file starting at given offset. Returns number
+  // of bytes read, which is smaller than size only at the end of file.
+  std::size_t read(
+    std::size_t file, std::uint64_t offset, char * buffer, std::size_t size);
+  
+private:
+  // Segments of a rebuilt sample.
+  struct file_index {
+    // Checkpoints at the beginning of each segment.
+    std::vector<vorbis::rebuilder::checkpoint> segments;
+    std::uint64_t size = 0;
+  };
+  
+  // Returns index of a file, building it on first use.
+  std::shared_ptr<const file_index> index(std::size_t file);
+  
+  // Returns content of a segment of a file.
+  std::shared_ptr<const std::string> segment(
+    std::size_t file, const file_index & index, std::size_t segment);
+  
+  // Returns data of a sample.
+  std::shared_ptr<const std::vector<char>> sample_data(std::size_t file);
+  
+private:
+  // Approximate size of audio packets within a segment.
+  static const std::size_t segment_size = 64 * 1024;
+  // Number of samples with data kept in memory.
+  static const std::size_t cached_samples = 4;
+  
+  const std::string path_;
+  std::unique_ptr<container> container_;
+  std::vector<std::string> file_names_;
+  std::unordered_map<std::string, std::size_t> files_;
+  const std::size_t cached_segments_;
+  
+  std::mutex mutex_;
+  std::vector<std::shared_ptr<const file_index>> indices_;
+  // Recently used segments, indexed by file and segment number, most
+  // recently used first.
+  typedef std::pair<std::size_t, std::size_t> segment_key;
+  std::list<std::pair<segment_key, std::shared_ptr<const std::string>>> 
+    segments_;
+  std::map<segment_key, decltype(segments_)::iterator> segments_index_;
+  // Recently used sample data, most recently used first.
+  std::list<std::pair<std::size_t, std::shared_ptr<const std::vector<char>>>>
+    samples_;
+};
+
+}
+
+#endif
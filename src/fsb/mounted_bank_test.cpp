@@ -0,0 +1,76 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/mounted_bank.hpp"
+#include "fsb/bench/synthetic.hpp"
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <sstream>
+
+using namespace fsb;
+
+namespace {
+
+TEST(mounted_bank_test, reads_match_rebuilt_samples) {
+  bench::synthetic_options options;
+  options.samples = 3;
+  options.sample_size = 300 * 1024;
+  options.password = "key";
+  const std::vector<char> buffer = bench::make_synthetic_container(options);
+  
+  const boost::filesystem::path path = 
+    boost::filesystem::temp_directory_path() / 
+    boost::filesystem::unique_path("fsb-bank-%%%%-%%%%.fsb");
+  {
+    std::ofstream stream(path.native(), std::ios_base::binary);
+    stream.write(buffer.data(), buffer.size());
+  }
+  
+  mounted_bank bank(path.native(), options.password, 2);
+  ASSERT_EQ(3u, bank.file_names().size());
+  ASSERT_EQ("2.sample_1.ogg", bank.file_names()[1]);
+  ASSERT_EQ(1, bank.find_file("2.sample_1.ogg"));
+  ASSERT_EQ(-1, bank.find_file("sample_1.ogg"));
+  
+  std::ifstream stream(path.native(), std::ios_base::binary);
+  container container(stream, options.password);
+  for (std::size_t i = 0; i < container.samples().size(); ++i) {
+    const sample & sample = container.samples()[i];
+    std::ostringstream expected;
+    std::vector<vorbis::rebuilder::checkpoint> segments;
+    vorbis::rebuilder().rebuild_segments(sample, container.sample_view(sample),
+      64 * 1024, expected, segments);
+    ASSERT_FALSE(segments.empty());
+    ASSERT_EQ(expected.str().size(), bank.file_size(i));
+    
+    // Reads of odd sizes cross segment boundaries, and evict cached ones.
+    std::string actual(expected.str().size(), '\0');
+    const std::size_t chunk = 7777;
+    for (std::size_t offset = 0; offset < actual.size(); offset += chunk) {
+      const std::size_t size = std::min(chunk, actual.size() - offset);
+      ASSERT_EQ(size, bank.read(i, offset, &actual[offset], chunk));
+    }
+    ASSERT_EQ(expected.str(), actual);
+    
+    char byte;
+    ASSERT_EQ(0u, bank.read(i, actual.size(), &byte, 1));
+    ASSERT_EQ(1u, bank.read(i, 0, &byte, 1));
+    ASSERT_EQ('O', byte);
+  }
+  
+  boost::filesystem::remove(path);
+}
+
+}
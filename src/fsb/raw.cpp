@@ -0,0 +1,73 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/raw.hpp"
+
+#include "fsb/container.hpp"
+#include "fsb/error.hpp"
+#include "fsb/trace.hpp"
+#include "fsb/io/file.hpp"
+
+#include <fstream>
+#include <ostream>
+
+namespace fsb {
+
+void write_sample_description(
+  std::ostream & os, const sample & sample, std::uint64_t duration) {
+  os
+    << "Name:          " << sample.name << '\n'
+    << "Frequency:     " << sample.frequency << '\n'
+    << "Channels:      " << int(sample.channels) << '\n'
+    << "Offset:        " << sample.offset << '\n'
+    << "Size:          " << sample.size << '\n';
+  if (duration != unknown_duration) {
+    os << "Duration:      " << duration << '\n';
+  }
+  os
+    << "Vorbis CRC-32: " << sample.vorbis_crc32 << '\n'
+    << "Loop start:    " << sample.loop_start << '\n'
+    << "Loop end:      " << sample.loop_end << '\n'
+    << "Unknown:       " << sample.unknown << '\n';
+}
+
+void write_raw(
+  const container & container,
+  const sample & sample,
+  std::uint64_t duration,
+  int source_fd,
+  const std::string & path) {
+  {
+    io::unique_fd output = io::open_for_writing(path);
+    if (source_fd != -1) {
+      io::copy_range(
+        source_fd, container.data_offset() + sample.offset,
+        output.get(), sample.size);
+    } else {
+      const io::buffer_view view = container.sample_view(sample);
+      io::write(output.get(), view.begin(), view.size());
+    }
+    trace::scoped_span span("close output");
+    output.close();
+  }
+  
+  const std::string description_path = path + ".txt";
+  std::ofstream description(description_path);
+  description 
+    << "Format:        " << int(container.file_header().mode) << '\n';
+  write_sample_description(description, sample, duration);
+  if (!description.flush()) {
+    throw error("Failed to write output file: " + description_path);
+  }
+}
+
+}
@@ -0,0 +1,47 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_RAW_HPP
+#define FSB_RAW_HPP
+
+#include "fsb/fsb.hpp"
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace fsb {
+
+class container;
+
+// Duration of a sample whose data was not scanned.
+const std::uint64_t unknown_duration = static_cast<std::uint64_t>(-1);
+
+// Writes description of a sample, a field per line. Duration is left out if 
+// it is unknown.
+void write_sample_description(
+  std::ostream & stream, const sample & sample, std::uint64_t duration);
+
+// Writes sample data as stored in container to a given path, and description
+// of the sample and container format next to it, with .txt appended to path.
+// Data is copied directly from source file if it is not -1, and from data
+// read into container otherwise.
+void write_raw(
+  const container & container,
+  const sample & sample,
+  std::uint64_t duration,
+  int source_fd,
+  const std::string & path);
+
+}
+
+#endif
@@ -0,0 +1,86 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/bench/synthetic.hpp"
+#include "fsb/container.hpp"
+#include "fsb/raw.hpp"
+#include "fsb/io/file.hpp"
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+using namespace fsb;
+
+namespace {
+
+std::string read_file(const boost::filesystem::path & path) {
+  std::ifstream stream(path.native(), std::ios_base::binary);
+  return std::string(
+    std::istreambuf_iterator<char>(stream),
+    std::istreambuf_iterator<char>());
+}
+
+TEST(raw_test, write_raw) {
+  bench::synthetic_options options;
+  options.samples = 3;
+  options.sample_size = 1000;
+  const std::vector<char> buffer = bench::make_synthetic_container(options);
+  
+  const boost::filesystem::path directory =
+    boost::filesystem::temp_directory_path() /
+    boost::filesystem::unique_path("fsb-raw-%%%%-%%%%");
+  boost::filesystem::create_directories(directory);
+  const boost::filesystem::path input = directory / "input.fsb";
+  {
+    std::ofstream stream(input.native(), std::ios_base::binary);
+    stream.write(buffer.data(), buffer.size());
+  }
+  
+  std::ifstream stream(input.native(), std::ios_base::binary);
+  container container(stream, "");
+  const sample & sample = container.samples()[1];
+  const io::buffer_view view = container.sample_view(sample);
+  const std::string data(view.begin(), view.size());
+  const std::uint64_t duration = 1234;
+  
+  // Copied from data in memory, with known duration.
+  const boost::filesystem::path memory = directory / "memory.raw";
+  write_raw(container, sample, duration, -1, memory.native());
+  ASSERT_EQ(data, read_file(memory));
+  const std::string description = read_file(memory.native() + ".txt");
+  ASSERT_NE(std::string::npos, description.find("Format:        15\n"));
+  ASSERT_NE(std::string::npos, description.find("Name:          sample_1\n"));
+  ASSERT_NE(std::string::npos, description.find("Duration:      1234\n"));
+  
+  // Copied directly from source file, without duration.
+  const boost::filesystem::path direct = directory / "direct.raw";
+  {
+    const io::unique_fd source = io::open_for_reading(input.native());
+    write_raw(container, sample, unknown_duration, source.get(), 
+      direct.native());
+  }
+  ASSERT_EQ(data, read_file(direct));
+  std::ostringstream expected;
+  expected << "Format:        15\n";
+  write_sample_description(expected, sample, unknown_duration);
+  ASSERT_EQ(expected.str(), read_file(direct.native() + ".txt"));
+  ASSERT_EQ(std::string::npos, expected.str().find("Duration"));
+  
+  boost::filesystem::remove_all(directory);
+}
+
+}
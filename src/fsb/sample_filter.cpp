@@ -0,0 +1,81 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/sample_filter.hpp"
+
+#include "fsb/error.hpp"
+
+#include <fnmatch.h>
+
+namespace fsb {
+
+void sample_filter::add_index(std::size_t index) {
+  indices_.insert(index);
+}
+
+void sample_filter::add_name(const std::string & name) {
+  names_.insert(name);
+}
+
+void sample_filter::add_glob(const std::string & pattern) {
+  globs_.push_back(pattern);
+}
+
+void sample_filter::add_regex(const std::string & expression) {
+  try {
+    regexes_.emplace_back(expression, std::regex::ECMAScript);
+  } catch (const std::regex_error &) {
+    throw error("Invalid regular expression: " + expression);
+  }
+}
+
+bool sample_filter::empty() const {
+  return indices_.empty() && names_.empty() && globs_.empty() && 
+    regexes_.empty();
+}
+
+bool sample_filter::matches(std::size_t index, boost::string_ref name) const {
+  if (empty() || indices_.count(index)) {
+    return true;
+  }
+  if (names_.empty() && globs_.empty() && regexes_.empty()) {
+    return false;
+  }
+  const std::string name_string = name.to_string();
+  if (names_.count(name_string)) {
+    return true;
+  }
+  for (const auto & pattern : globs_) {
+    if (fnmatch(pattern.c_str(), name_string.c_str(), 0) == 0) {
+      return true;
+    }
+  }
+  for (const auto & regex : regexes_) {
+    if (std::regex_search(name_string, regex)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<const sample *> sample_filter::select(
+  const std::vector<sample> & samples) const {
+  std::vector<const sample *> selected;
+  for (std::size_t i = 0; i < samples.size(); ++i) {
+    if (matches(i, samples[i].name)) {
+      selected.push_back(&samples[i]);
+    }
+  }
+  return selected;
+}
+
+}
@@ -0,0 +1,64 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_SAMPLE_FILTER_HPP
+#define FSB_SAMPLE_FILTER_HPP
+
+#include "fsb/fsb.hpp"
+
+#include <boost/utility/string_ref.hpp>
+
+#include <cstddef>
+#include <regex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace fsb {
+
+// Selects samples of a container by index, name, wildcard pattern or regular
+// expression. Sample is selected if it matches any of the criteria, or if 
+// there are none.
+class sample_filter {
+public:
+  // Selects sample with a given zero-based index within container.
+  void add_index(std::size_t index);
+  
+  // Selects sample with a given name.
+  void add_name(const std::string & name);
+  
+  // Selects samples with names matching a shell wildcard pattern.
+  void add_glob(const std::string & pattern);
+  
+  // Selects samples with names containing a match of ECMAScript regular
+  // expression. Throws error if expression is invalid.
+  void add_regex(const std::string & expression);
+  
+  // Returns true if all samples are selected.
+  bool empty() const;
+  
+  // Returns true if sample with a given index and name is selected.
+  bool matches(std::size_t index, boost::string_ref name) const;
+  
+  // Returns selected samples in order of their appearance.
+  std::vector<const sample *> select(const std::vector<sample> & samples) const;
+  
+private:
+  std::set<std::size_t> indices_;
+  std::set<std::string> names_;
+  std::vector<std::string> globs_;
+  std::vector<std::regex> regexes_;
+};
+
+}
+
+#endif
@@ -0,0 +1,77 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/sample_filter.hpp"
+#include "fsb/error.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace fsb;
+
+namespace {
+
+TEST(sample_filter_test, empty_filter_selects_everything) {
+  const sample_filter filter;
+  ASSERT_TRUE(filter.empty());
+  ASSERT_TRUE(filter.matches(0, "a"));
+  ASSERT_TRUE(filter.matches(100, ""));
+}
+
+TEST(sample_filter_test, any_criterion_selects_sample) {
+  sample_filter filter;
+  filter.add_index(2);
+  filter.add_name("exact");
+  filter.add_glob("vo_*_01");
+  filter.add_regex("^music_[0-9]+$");
+  ASSERT_FALSE(filter.empty());
+  
+  ASSERT_TRUE(filter.matches(2, "other"));
+  ASSERT_TRUE(filter.matches(0, "exact"));
+  ASSERT_TRUE(filter.matches(0, "vo_intro_01"));
+  ASSERT_TRUE(filter.matches(0, "music_12"));
+  
+  ASSERT_FALSE(filter.matches(3, "other"));
+  ASSERT_FALSE(filter.matches(0, "exact2"));
+  ASSERT_FALSE(filter.matches(0, "vo_intro_02"));
+  ASSERT_FALSE(filter.matches(0, "music_x"));
+}
+
+TEST(sample_filter_test, regex_matches_part_of_name) {
+  sample_filter filter;
+  filter.add_regex("boss");
+  ASSERT_TRUE(filter.matches(0, "final_boss_theme"));
+  ASSERT_FALSE(filter.matches(0, "final_theme"));
+}
+
+TEST(sample_filter_test, select) {
+  std::vector<sample> samples(4);
+  samples[0].name = "a1";
+  samples[1].name = "b1";
+  samples[2].name = "a2";
+  samples[3].name = "b2";
+  
+  sample_filter filter;
+  filter.add_glob("a*");
+  filter.add_index(3);
+  const std::vector<const sample *> selected = filter.select(samples);
+  ASSERT_EQ(3u, selected.size());
+  ASSERT_EQ(&samples[0], selected[0]);
+  ASSERT_EQ(&samples[2], selected[1]);
+  ASSERT_EQ(&samples[3], selected[2]);
+}
+
+TEST(sample_filter_test, invalid_regex) {
+  sample_filter filter;
+  ASSERT_THROW(filter.add_regex("(unclosed"), fsb::error);
+}
+
+}
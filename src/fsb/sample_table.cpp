@@ -0,0 +1,147 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/sample_table.hpp"
+
+#include "fsb/error.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+
+namespace fsb {
+
+namespace {
+
+// Returns code of a value, adding it to the table of values if necessary.
+template <typename T>
+std::uint16_t intern(
+  const T & value, 
+  std::map<T, std::uint16_t> & codes, 
+  std::vector<T> & values) {
+  const auto it = codes.find(value);
+  if (it != codes.end()) {
+    return it->second;
+  }
+  if (values.size() > std::numeric_limits<std::uint16_t>::max()) {
+    throw error("Too many distinct values in sample table.");
+  }
+  const std::uint16_t code = static_cast<std::uint16_t>(values.size());
+  codes.emplace(value, code);
+  values.push_back(value);
+  return code;
+}
+
+// Returns number of bytes allocated by a vector.
+template <typename T>
+std::size_t allocated(const std::vector<T> & vector) {
+  return vector.capacity() * sizeof(T);
+}
+
+}
+
+sample_table::sample_table(const std::vector<sample> & samples) {
+  if (samples.empty()) {
+    return;
+  }
+  
+  std::map<std::pair<std::uint32_t, std::uint8_t>, std::uint16_t> format_codes;
+  std::map<std::uint32_t, std::uint16_t> crc_codes;
+  offsets_.reserve(samples.size() + 1);
+  format_codes_.reserve(samples.size());
+  crc_codes_.reserve(samples.size());
+  name_offsets_.reserve(samples.size() + 1);
+  
+  std::uint64_t end = samples.front().offset;
+  for (std::size_t i = 0; i < samples.size(); ++i) {
+    const sample & sample = samples[i];
+    if (sample.offset != end) {
+      throw error("Samples are not contiguous.");
+    }
+    end = sample.offset + sample.size;
+    if (end > std::numeric_limits<std::uint32_t>::max()) {
+      throw error("Sample exceeds 32-bit data section.");
+    }
+    
+    offsets_.push_back(static_cast<std::uint32_t>(sample.offset));
+    format_codes_.push_back(intern(std::make_pair(
+      sample.frequency, sample.channels), format_codes, formats_));
+    crc_codes_.push_back(intern(sample.vorbis_crc32, crc_codes, crcs_));
+    
+    name_offsets_.push_back(static_cast<std::uint32_t>(names_.size()));
+    names_.append(sample.name.begin(), sample.name.end());
+    names_.push_back('\0');
+    
+    if (sample.loop_start || sample.loop_end) {
+      loops_.push_back({static_cast<std::uint32_t>(i), 
+        sample.loop_start, sample.loop_end});
+    }
+    if (sample.seek_granulepos && seek_granulepos_.empty()) {
+      seek_granulepos_.resize(samples.size());
+    }
+    if (!seek_granulepos_.empty()) {
+      seek_granulepos_[i] = sample.seek_granulepos;
+    }
+    if (sample.unknown && unknown_.empty()) {
+      unknown_.resize(samples.size());
+    }
+    if (!unknown_.empty()) {
+      unknown_[i] = sample.unknown;
+    }
+  }
+  offsets_.push_back(static_cast<std::uint32_t>(end));
+  name_offsets_.push_back(static_cast<std::uint32_t>(names_.size()));
+  
+  names_.shrink_to_fit();
+  loops_.shrink_to_fit();
+}
+
+sample sample_table::operator[](std::size_t index) const {
+  sample result;
+  result.name = name(index);
+  result.frequency = frequency(index);
+  result.channels = channels(index);
+  result.offset = offset(index);
+  result.size = sample_size(index);
+  result.vorbis_crc32 = vorbis_crc32(index);
+  
+  const auto loop = std::lower_bound(loops_.begin(), loops_.end(), index,
+    [](const sample_table::loop & loop, std::size_t index) {
+      return loop.index < index;
+    });
+  if (loop != loops_.end() && loop->index == index) {
+    result.loop_start = loop->start;
+    result.loop_end = loop->end;
+  }
+  if (!seek_granulepos_.empty()) {
+    result.seek_granulepos = seek_granulepos_[index];
+  }
+  if (!unknown_.empty()) {
+    result.unknown = unknown_[index];
+  }
+  return result;
+}
+
+boost::string_ref sample_table::name(std::size_t index) const {
+  // Names are followed by null characters, which are not part of them.
+  return boost::string_ref(names_.data() + name_offsets_[index], 
+    name_offsets_[index + 1] - name_offsets_[index] - 1);
+}
+
+std::size_t sample_table::memory_usage() const {
+  return allocated(offsets_) + allocated(format_codes_) + 
+    allocated(formats_) + allocated(crc_codes_) + allocated(crcs_) +
+    allocated(name_offsets_) + names_.capacity() + allocated(loops_) +
+    allocated(seek_granulepos_) + allocated(unknown_);
+}
+
+}
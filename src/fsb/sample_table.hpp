@@ -0,0 +1,111 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_SAMPLE_TABLE_HPP
+#define FSB_SAMPLE_TABLE_HPP
+
+#include "fsb/fsb.hpp"
+
+#include <boost/utility/string_ref.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fsb {
+
+// Compact metadata of container samples, meant for keeping many containers
+// in memory at once. Each field is stored in a separate column:
+//
+// * offsets are packed into 32 bits, and sizes are derived from offsets of 
+//   the following samples, as samples are laid out contiguously,
+// * frequency and number of channels pairs, and CRC-32 of Vorbis setup 
+//   headers are interned into small tables, and only their 16-bit codes are
+//   stored per sample,
+// * names are stored one after another in a single buffer,
+// * loop points are kept only for samples that have them, and remaining 
+//   fields only if any sample has them.
+class sample_table {
+public:
+  sample_table() = default;
+  
+  // Builds table from samples of a container. Samples must be laid out
+  // contiguously, in order of their offsets. Throws fsb::error otherwise.
+  explicit sample_table(const std::vector<sample> & samples);
+  
+  // Returns number of samples.
+  std::size_t size() const {
+    return offsets_.empty() ? 0 : offsets_.size() - 1;
+  }
+  
+  bool empty() const {
+    return size() == 0;
+  }
+  
+  // Returns sample with a given index. Its name is a view on the table.
+  sample operator[](std::size_t index) const;
+  
+  boost::string_ref name(std::size_t index) const;
+  
+  std::size_t offset(std::size_t index) const {
+    return offsets_[index];
+  }
+  
+  std::size_t sample_size(std::size_t index) const {
+    return offsets_[index + 1] - offsets_[index];
+  }
+  
+  std::uint32_t frequency(std::size_t index) const {
+    return formats_[format_codes_[index]].first;
+  }
+  
+  std::uint8_t channels(std::size_t index) const {
+    return formats_[format_codes_[index]].second;
+  }
+  
+  std::uint32_t vorbis_crc32(std::size_t index) const {
+    return crcs_[crc_codes_[index]];
+  }
+  
+  // Returns number of bytes allocated by the table.
+  std::size_t memory_usage() const;
+  
+private:
+  // Loop points of a sample.
+  struct loop {
+    std::uint32_t index;
+    std::uint32_t start;
+    std::uint32_t end;
+  };
+  
+  // Offsets of samples, followed by the end offset of the last one.
+  std::vector<std::uint32_t> offsets_;
+  std::vector<std::uint16_t> format_codes_;
+  std::vector<std::pair<std::uint32_t, std::uint8_t>> formats_;
+  std::vector<std::uint16_t> crc_codes_;
+  std::vector<std::uint32_t> crcs_;
+  // Offsets of null terminated names within names buffer, followed by the
+  // size of the buffer.
+  std::vector<std::uint32_t> name_offsets_;
+  std::string names_;
+  // Loops ordered by sample index.
+  std::vector<loop> loops_;
+  // Optional columns, empty if all their values are zero.
+  std::vector<std::uint32_t> seek_granulepos_;
+  std::vector<std::uint32_t> unknown_;
+};
+
+}
+
+#endif
@@ -0,0 +1,101 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/sample_table.hpp"
+
+#include "fsb/error.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using namespace fsb;
+
+namespace {
+
+void expect_same(const sample & expected, const sample & actual) {
+  EXPECT_EQ(expected.name, actual.name);
+  EXPECT_EQ(expected.frequency, actual.frequency);
+  EXPECT_EQ(expected.channels, actual.channels);
+  EXPECT_EQ(expected.offset, actual.offset);
+  EXPECT_EQ(expected.size, actual.size);
+  EXPECT_EQ(expected.vorbis_crc32, actual.vorbis_crc32);
+  EXPECT_EQ(expected.loop_start, actual.loop_start);
+  EXPECT_EQ(expected.loop_end, actual.loop_end);
+  EXPECT_EQ(expected.seek_granulepos, actual.seek_granulepos);
+  EXPECT_EQ(expected.unknown, actual.unknown);
+}
+
+TEST(sample_table_test, empty) {
+  const sample_table table((std::vector<sample>()));
+  ASSERT_TRUE(table.empty());
+  ASSERT_EQ(0u, table.size());
+}
+
+TEST(sample_table_test, samples_are_preserved) {
+  const std::vector<std::string> names {"first", "", "third", "fourth"};
+  std::vector<sample> samples(names.size());
+  std::size_t offset = 64;
+  for (std::size_t i = 0; i < samples.size(); ++i) {
+    samples[i].name = names[i];
+    samples[i].frequency = i % 2 ? 44100 : 22050;
+    samples[i].channels = i % 2 ? 2 : 1;
+    samples[i].offset = offset;
+    samples[i].size = 32 * (i + 1);
+    samples[i].vorbis_crc32 = 0xdeadbeef + i % 2;
+    samples[i].seek_granulepos = 1000 * i;
+    offset += samples[i].size;
+  }
+  samples[2].loop_start = 10;
+  samples[2].loop_end = 20;
+  samples[3].unknown = 7;
+  
+  const sample_table table(samples);
+  ASSERT_EQ(samples.size(), table.size());
+  for (std::size_t i = 0; i < samples.size(); ++i) {
+    expect_same(samples[i], table[i]);
+    EXPECT_EQ(samples[i].name, table.name(i));
+    EXPECT_EQ(samples[i].size, table.sample_size(i));
+  }
+}
+
+TEST(sample_table_test, smaller_than_samples) {
+  std::vector<sample> samples(10000);
+  std::vector<std::string> names(samples.size());
+  for (std::size_t i = 0; i < samples.size(); ++i) {
+    names[i] = "sample_" + std::to_string(i);
+    samples[i].name = names[i];
+    samples[i].frequency = 44100;
+    samples[i].channels = 2;
+    samples[i].offset = 1024 * i;
+    samples[i].size = 1024;
+    samples[i].vorbis_crc32 = i % 3;
+  }
+  
+  const sample_table table(samples);
+  expect_same(samples[1234], table[1234]);
+  // Names alone take 11 bytes on average.
+  ASSERT_LT(table.memory_usage(), 
+    samples.size() * (sizeof(sample) + 11) / 2);
+}
+
+TEST(sample_table_test, samples_must_be_contiguous) {
+  std::vector<sample> samples(2);
+  samples[0].offset = 0;
+  samples[0].size = 32;
+  samples[1].offset = 64;
+  samples[1].size = 32;
+  ASSERT_THROW(sample_table table(samples), error);
+}
+
+}
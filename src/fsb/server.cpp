@@ -0,0 +1,390 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/server.hpp"
+
+#include "fsb/error.hpp"
+#include "fsb/trace.hpp"
+#include "fsb/vorbis/rebuilder.hpp"
+
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <glog/logging.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace fsb {
+
+const std::size_t server::max_request_size;
+
+namespace {
+
+// Splits string into tab separated fields.
+std::vector<std::string> split_fields(const std::string & line) {
+  std::vector<std::string> fields;
+  std::string::size_type begin = 0;
+  for (;;) {
+    const std::string::size_type end = line.find('\t', begin);
+    fields.push_back(line.substr(begin, end - begin));
+    if (end == std::string::npos) {
+      return fields;
+    }
+    begin = end + 1;
+  }
+}
+
+// Sends exactly size bytes. Returns false if peer went away.
+bool send_all(int fd, const char * data, std::size_t size) {
+  while (size > 0) {
+    const ssize_t sent = ::send(fd, data, size, MSG_NOSIGNAL);
+    if (sent == -1 && errno == EINTR) {
+      continue;
+    }
+    if (sent <= 0) {
+      return false;
+    }
+    data += sent;
+    size -= sent;
+  }
+  return true;
+}
+
+// Returns true if a server accepts connections on a given socket.
+bool accepts_connections(const sockaddr_un & address) {
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1) {
+    throw error(
+      std::string("Failed to create socket: ") + std::strerror(errno));
+  }
+  const bool connected = ::connect(
+    fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+  ::close(fd);
+  return connected;
+}
+
+}
+
+cached_container::cached_container(
+  const std::string & path, const std::string & password) {
+  std::ifstream stream(path, std::ios_base::in | std::ios_base::binary);
+  if (!stream) {
+    throw error("Failed to open path: " + path);
+  }
+  container.reset(new fsb::container(stream, password));
+}
+
+const sample * cached_container::find_sample(const std::string & name) const {
+  const auto & samples = container->samples();
+  if (!name.empty() && name[0] == '#') {
+    char * end = nullptr;
+    const unsigned long index = std::strtoul(name.c_str() + 1, &end, 10);
+    if (*end != '\0' || end == name.c_str() + 1 || index >= samples.size()) {
+      return nullptr;
+    }
+    return &samples[index];
+  }
+  return container->find_sample(name);
+}
+
+container_cache::container_cache(std::size_t capacity)
+  : capacity_(capacity) {
+  CHECK(capacity_ > 0) << "Cache capacity must be positive.";
+}
+
+std::shared_ptr<const cached_container> container_cache::get(
+  const std::string & path, const std::string & password) {
+  
+  struct stat status;
+  if (::stat(path.c_str(), &status) == -1) {
+    throw error("Failed to open path: " + path + ": " + std::strerror(errno));
+  }
+  const std::int64_t mtime = 
+    std::int64_t(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+  const std::string key = path + '\0' + password;
+  
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = index_.find(key);
+    if (it != index_.end()) {
+      const auto position = it->second;
+      if (position->size == std::uint64_t(status.st_size) && 
+          position->mtime == mtime) {
+        entries_.splice(entries_.begin(), entries_, position);
+        return position->container;
+      }
+      entries_.erase(position);
+      index_.erase(it);
+    }
+  }
+  
+  // Opens container without holding the lock, so that other lookups can
+  // proceed meanwhile.
+  std::shared_ptr<const cached_container> container;
+  {
+    trace::scoped_span span("open container", path);
+    container = std::make_shared<const cached_container>(path, password);
+  }
+  
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (index_.count(key) == 0) {
+    entries_.push_front(
+      entry {key, std::uint64_t(status.st_size), mtime, container});
+    index_.emplace(key, entries_.begin());
+    if (entries_.size() > capacity_) {
+      index_.erase(entries_.back().key);
+      entries_.pop_back();
+    }
+  }
+  return container;
+}
+
+std::size_t container_cache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+server::server(
+  const std::string & socket_path,
+  std::size_t cache_capacity,
+  const std::string & default_password,
+  std::size_t max_connections)
+  : socket_path_(socket_path)
+  , default_password_(default_password)
+  , max_connections_(max_connections)
+  , listen_fd_(-1)
+  , stopping_(false)
+  , cache_(cache_capacity) {
+  
+  sockaddr_un address {};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    throw error("Socket path is too long: " + socket_path);
+  }
+  std::strcpy(address.sun_path, socket_path.c_str());
+  
+  struct stat status;
+  if (::lstat(socket_path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)) {
+    if (accepts_connections(address)) {
+      throw error("Socket is already in use: " + socket_path);
+    }
+    ::unlink(socket_path.c_str());
+  }
+  
+  listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd_ == -1) {
+    throw error(
+      std::string("Failed to create socket: ") + std::strerror(errno));
+  }
+  if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), 
+             sizeof(address)) == -1 ||
+      ::listen(listen_fd_, SOMAXCONN) == -1) {
+    const std::string reason = std::strerror(errno);
+    ::close(listen_fd_);
+    throw error("Failed to listen on " + socket_path + ": " + reason);
+  }
+}
+
+server::~server() {
+  ::close(listen_fd_);
+  ::unlink(socket_path_.c_str());
+}
+
+void server::run() {
+  // Connection threads use the server, so they are shut down and waited for
+  // however accepting ends.
+  std::exception_ptr failure;
+  try {
+    accept_connections();
+  } catch (...) {
+    failure = std::current_exception();
+  }
+  
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (const int fd : connections_) {
+    ::shutdown(fd, SHUT_RDWR);
+  }
+  connections_closed_.wait(lock, [this] { return connections_.empty(); });
+  lock.unlock();
+  
+  if (failure) {
+    std::rethrow_exception(failure);
+  }
+}
+
+void server::accept_connections() {
+  while (!stopping_) {
+    const int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd == -1) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      if (stopping_) {
+        break;
+      }
+      if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || 
+          errno == ENOMEM) {
+        // Resources are released as connections are closed.
+        LOG(WARNING) << "accept failed: " << std::strerror(errno);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        continue;
+      }
+      throw error(std::string("accept failed: ") + std::strerror(errno));
+    }
+    
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stopping_) {
+      ::close(fd);
+      break;
+    }
+    if (connections_.size() >= max_connections_) {
+      lock.unlock();
+      const std::string status = "error Too many connections.\n";
+      send_all(fd, status.data(), status.size());
+      ::close(fd);
+      continue;
+    }
+    connections_.insert(fd);
+    try {
+      std::thread([this, fd] {
+        serve_connection(fd);
+        std::lock_guard<std::mutex> lock(mutex_);
+        ::close(fd);
+        connections_.erase(fd);
+        if (connections_.empty()) {
+          connections_closed_.notify_all();
+        }
+      }).detach();
+    } catch (const std::system_error & e) {
+      connections_.erase(fd);
+      ::close(fd);
+      LOG(WARNING) << "Failed to start connection thread: " << e.what();
+    }
+  }
+}
+
+void server::stop() {
+  stopping_ = true;
+  ::shutdown(listen_fd_, SHUT_RDWR);
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const int fd : connections_) {
+    ::shutdown(fd, SHUT_RDWR);
+  }
+}
+
+void server::serve_connection(int fd) {
+  std::unique_ptr<vorbis::rebuilder> rebuilder = acquire_rebuilder();
+  std::string pending;
+  std::string status;
+  std::string body;
+  char buffer[4096];
+  
+  for (;;) {
+    const std::string::size_type newline = pending.find('\n');
+    if (newline == std::string::npos) {
+      const ssize_t bytes = ::read(fd, buffer, sizeof(buffer));
+      if (bytes == -1 && errno == EINTR) {
+        continue;
+      }
+      if (bytes <= 0) {
+        break;
+      }
+      pending.append(buffer, bytes);
+      if (pending.size() > max_request_size && 
+          pending.find('\n') > max_request_size) {
+        const std::string status = "error Request is too long.\n";
+        send_all(fd, status.data(), status.size());
+        break;
+      }
+      continue;
+    }
+    
+    const std::string request = pending.substr(0, newline);
+    pending.erase(0, newline + 1);
+    handle_request(request, *rebuilder, status, body);
+    if (!send_all(fd, status.data(), status.size()) ||
+        !send_all(fd, body.data(), body.size())) {
+      break;
+    }
+  }
+  
+  release_rebuilder(std::move(rebuilder));
+}
+
+void server::handle_request(
+  const std::string & request, 
+  vorbis::rebuilder & rebuilder,
+  std::string & status,
+  std::string & body) {
+  
+  body.clear();
+  try {
+    const std::vector<std::string> fields = split_fields(request);
+    if (fields[0] != "extract" || fields.size() < 3 || fields.size() > 4) {
+      throw error("Malformed request.");
+    }
+    const std::string & password = 
+      fields.size() == 4 ? fields[3] : default_password_;
+    const std::shared_ptr<const cached_container> container = 
+      cache_.get(fields[1], password);
+    const sample * const sample = container->find_sample(fields[2]);
+    if (!sample) {
+      throw error("No such sample: " + fields[2]);
+    }
+    
+    trace::scoped_span span("sample", sample->name);
+    boost::iostreams::stream<
+      boost::iostreams::back_insert_device<std::string>> stream(body);
+    container->container->extract_sample(*sample, stream, rebuilder);
+    stream.flush();
+    status = "ok " + std::to_string(body.size()) + '\n';
+  } catch (const std::exception & e) {
+    body.clear();
+    std::string message = e.what();
+    for (char & c : message) {
+      if (c == '\n') {
+        c = ' ';
+      }
+    }
+    status = "error " + message + '\n';
+  }
+}
+
+std::unique_ptr<vorbis::rebuilder> server::acquire_rebuilder() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (rebuilders_.empty()) {
+    return std::unique_ptr<vorbis::rebuilder>(new vorbis::rebuilder());
+  }
+  std::unique_ptr<vorbis::rebuilder> rebuilder = std::move(rebuilders_.back());
+  rebuilders_.pop_back();
+  return rebuilder;
+}
+
+void server::release_rebuilder(std::unique_ptr<vorbis::rebuilder> rebuilder) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  rebuilders_.push_back(std::move(rebuilder));
+}
+
+}
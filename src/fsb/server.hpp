@@ -0,0 +1,147 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_SERVER_HPP
+#define FSB_SERVER_HPP
+
+#include "fsb/container.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fsb {
+
+namespace vorbis {
+class rebuilder;
+}
+
+// Container read into memory.
+struct cached_container {
+  cached_container(const std::string & path, const std::string & password);
+  
+  // Returns sample with given name, or with given index if name is of form
+  // #INDEX. Returns null if there is no such sample.
+  const sample * find_sample(const std::string & name) const;
+  
+  std::unique_ptr<fsb::container> container;
+};
+
+// Least recently used cache of containers. Containers are reopened when size
+// or modification time of their file changes. Thread safe.
+class container_cache {
+  container_cache(const container_cache &) = delete;
+  container_cache & operator=(const container_cache &) = delete;
+public:
+  explicit container_cache(std::size_t capacity);
+  
+  // Returns container at given path, opening it if it is not cached.
+  std::shared_ptr<const cached_container> get(
+    const std::string & path, const std::string & password);
+  
+  // Returns number of cached containers.
+  std::size_t size() const;
+  
+private:
+  struct entry {
+    std::string key;
+    std::uint64_t size;
+    // Modification time in nanoseconds.
+    std::int64_t mtime;
+    std::shared_ptr<const cached_container> container;
+  };
+  
+  const std::size_t capacity_;
+  mutable std::mutex mutex_;
+  // Entries, the most recently used first.
+  std::list<entry> entries_;
+  std::unordered_map<std::string, std::list<entry>::iterator> index_;
+};
+
+// Serves extraction requests over a Unix stream socket.
+//
+// Request is a line with tab separated fields "extract", path of container, 
+// sample name (or #INDEX) and optionally a password. Response is a line 
+// "ok SIZE" followed by SIZE bytes of extracted sample, or a line 
+// "error MESSAGE". A connection can carry any number of requests. Requests 
+// longer than max_request_size are rejected and their connection is closed.
+class server {
+  server(const server &) = delete;
+  server & operator=(const server &) = delete;
+public:
+  // Longest request line accepted, without the newline.
+  static const std::size_t max_request_size = 4096;
+  
+  // Listens on a given path, replacing stale socket left there. Fails if
+  // another server is listening on it. Connections above max_connections 
+  // are rejected with an error response.
+  server(
+    const std::string & socket_path,
+    std::size_t cache_capacity,
+    const std::string & default_password,
+    std::size_t max_connections = 64);
+  
+  // Removes the socket.
+  ~server();
+  
+  // Accepts connections, each served by its own thread, until stop is called.
+  // Returns, or throws if accepting failed, only once all connections are 
+  // closed.
+  void run();
+  
+  // Stops accepting connections and closes existing ones. 
+  void stop();
+  
+private:
+  // Accepts connections until stop is called. Throws if accept fails for a
+  // reason other than lack of resources.
+  void accept_connections();
+  
+  void serve_connection(int fd);
+  
+  // Handles a single request line, producing response status line and body.
+  void handle_request(
+    const std::string & request, 
+    vorbis::rebuilder & rebuilder,
+    std::string & status,
+    std::string & body);
+  
+  std::unique_ptr<vorbis::rebuilder> acquire_rebuilder();
+  void release_rebuilder(std::unique_ptr<vorbis::rebuilder> rebuilder);
+  
+private:
+  const std::string socket_path_;
+  const std::string default_password_;
+  const std::size_t max_connections_;
+  int listen_fd_;
+  std::atomic<bool> stopping_;
+  container_cache cache_;
+  
+  std::mutex mutex_;
+  // Open connections. Notified when the last one is closed.
+  std::set<int> connections_;
+  std::condition_variable connections_closed_;
+  // Rebuilders of finished connections, with warm block sizes tables.
+  std::vector<std::unique_ptr<vorbis::rebuilder>> rebuilders_;
+};
+
+}
+
+#endif
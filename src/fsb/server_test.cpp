@@ -0,0 +1,240 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/server.hpp"
+
+#include "fsb/bench/synthetic.hpp"
+#include "fsb/error.hpp"
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace fsb;
+
+namespace {
+
+// Writes synthetic container with given number of samples.
+void write_container(
+  const boost::filesystem::path & path, std::size_t samples) {
+  bench::synthetic_options options;
+  options.samples = samples;
+  options.sample_size = 1000;
+  const std::vector<char> buffer = bench::make_synthetic_container(options);
+  std::ofstream stream(path.native(), std::ios_base::binary);
+  stream.write(buffer.data(), buffer.size());
+}
+
+// Connects to a socket and sends requests.
+class client {
+public:
+  explicit client(const std::string & path)
+    : fd_(::socket(AF_UNIX, SOCK_STREAM, 0)) {
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path.c_str());
+    EXPECT_EQ(0, ::connect(
+      fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)));
+  }
+  
+  ~client() {
+    ::close(fd_);
+  }
+  
+  // Sends request and returns status line, storing response body in body.
+  std::string request(const std::string & line, std::string & body) {
+    const std::string request = line + '\n';
+    EXPECT_EQ(ssize_t(request.size()), 
+      ::write(fd_, request.data(), request.size()));
+    
+    const std::string status = read_line();
+    body.clear();
+    if (status.compare(0, 3, "ok ") == 0) {
+      body.resize(std::stoul(status.substr(3)));
+      std::size_t offset = 0;
+      while (offset < body.size()) {
+        const ssize_t bytes = 
+          ::read(fd_, &body[offset], body.size() - offset);
+        if (bytes <= 0) {
+          break;
+        }
+        offset += bytes;
+      }
+    }
+    return status;
+  }
+  
+  // Reads a line without the newline.
+  std::string read_line() {
+    std::string line;
+    char c;
+    while (::read(fd_, &c, 1) == 1 && c != '\n') {
+      line.push_back(c);
+    }
+    return line;
+  }
+  
+private:
+  int fd_;
+};
+
+class server_test : public ::testing::Test {
+protected:
+  void SetUp() override {
+    directory_ = 
+      boost::filesystem::temp_directory_path() / 
+      boost::filesystem::unique_path();
+    boost::filesystem::create_directories(directory_);
+  }
+  
+  void TearDown() override {
+    boost::filesystem::remove_all(directory_);
+  }
+  
+  boost::filesystem::path directory_;
+};
+
+TEST_F(server_test, cache_evicts_least_recently_used) {
+  const std::string a = (directory_ / "a.fsb").native();
+  const std::string b = (directory_ / "b.fsb").native();
+  const std::string c = (directory_ / "c.fsb").native();
+  write_container(a, 1);
+  write_container(b, 2);
+  write_container(c, 3);
+  
+  container_cache cache(2);
+  const auto first = cache.get(a, "");
+  ASSERT_EQ(1u, first->container->samples().size());
+  ASSERT_EQ(first, cache.get(a, ""));
+  cache.get(b, "");
+  cache.get(a, "");
+  cache.get(c, "");
+  ASSERT_EQ(2u, cache.size());
+  // Container b was evicted, while a was used recently.
+  ASSERT_EQ(first, cache.get(a, ""));
+  
+  // Modified container is reopened.
+  write_container(a, 4);
+  ASSERT_EQ(4u, cache.get(a, "")->container->samples().size());
+  
+  ASSERT_THROW(cache.get((directory_ / "missing.fsb").native(), ""), error);
+}
+
+TEST_F(server_test, find_sample) {
+  const std::string path = (directory_ / "a.fsb").native();
+  write_container(path, 3);
+  const cached_container container(path, "");
+  ASSERT_EQ("sample_1", container.find_sample("sample_1")->name);
+  ASSERT_EQ("sample_2", container.find_sample("#2")->name);
+  ASSERT_EQ(nullptr, container.find_sample("#3"));
+  ASSERT_EQ(nullptr, container.find_sample("#"));
+  ASSERT_EQ(nullptr, container.find_sample("sample_3"));
+}
+
+TEST_F(server_test, extracts_samples) {
+  const std::string path = (directory_ / "a.fsb").native();
+  write_container(path, 3);
+  std::ifstream stream(path, std::ios_base::binary);
+  container expected(stream, "");
+  
+  const std::string socket_path = (directory_ / "socket").native();
+  server server(socket_path, 4, "");
+  std::thread thread([&] { server.run(); });
+  
+  {
+    client client(socket_path);
+    std::string body;
+    for (int repetition = 0; repetition != 2; ++repetition) {
+      for (const auto & sample : expected.samples()) {
+        std::ostringstream output;
+        expected.extract_sample(sample, output);
+        ASSERT_EQ(
+          "ok " + std::to_string(output.str().size()),
+          client.request("extract\t" + path + "\t" + sample.name.to_string(), body));
+        ASSERT_EQ(output.str(), body);
+      }
+    }
+    
+    ASSERT_EQ("ok", client.request("extract\t" + path + "\t#0", body)
+      .substr(0, 2));
+    ASSERT_EQ("error No such sample: x", 
+      client.request("extract\t" + path + "\tx", body));
+    ASSERT_EQ("error Malformed request.", client.request("list", body));
+  }
+  
+  server.stop();
+  thread.join();
+}
+
+TEST_F(server_test, rejects_too_long_requests) {
+  const std::string socket_path = (directory_ / "socket").native();
+  server server(socket_path, 4, "");
+  std::thread thread([&] { server.run(); });
+  
+  {
+    client client(socket_path);
+    std::string body;
+    ASSERT_EQ("error Malformed request.", 
+      client.request(std::string(server::max_request_size, 'x'), body));
+    ASSERT_EQ("error Request is too long.", 
+      client.request(std::string(2 * server::max_request_size, 'x'), body));
+  }
+  
+  server.stop();
+  thread.join();
+}
+
+TEST_F(server_test, rejects_connections_above_limit) {
+  const std::string socket_path = (directory_ / "socket").native();
+  server server(socket_path, 4, "", 1);
+  std::thread thread([&] { server.run(); });
+  
+  {
+    client first(socket_path);
+    std::string body;
+    // Connection is being served once it responds.
+    ASSERT_EQ("error Malformed request.", first.request("list", body));
+    client second(socket_path);
+    ASSERT_EQ("error Too many connections.", second.read_line());
+  }
+  
+  server.stop();
+  thread.join();
+}
+
+TEST_F(server_test, replaces_only_stale_socket) {
+  const std::string socket_path = (directory_ / "socket").native();
+  
+  // Socket left by a server that is gone.
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address {};
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, socket_path.c_str());
+  ASSERT_EQ(0, ::bind(fd, reinterpret_cast<sockaddr*>(&address), 
+                      sizeof(address)));
+  ::close(fd);
+  
+  server first(socket_path, 4, "");
+  ASSERT_THROW(server second(socket_path, 4, ""), error);
+}
+
+}
@@ -0,0 +1,123 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_SPSC_QUEUE_HPP
+#define FSB_SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace fsb {
+
+// Bounded queue with a single producer and a single consumer. Elements are
+// handed over without locking, mutex is taken only to sleep while queue is 
+// full or empty, and to wake up sleeping side.
+template <typename T>
+class spsc_queue {
+  spsc_queue(const spsc_queue &) = delete;
+  spsc_queue & operator=(const spsc_queue &) = delete;
+public:
+  explicit spsc_queue(std::size_t capacity)
+    : slots_(capacity + 1)
+    , head_(0)
+    , tail_(0)
+    , waiters_(0) {
+  }
+  
+  // Appends element if queue is not full. Returns true on success.
+  bool try_push(T & value) {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    const std::size_t next = advance(tail);
+    if (next == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    slots_[tail] = std::move(value);
+    tail_.store(next, std::memory_order_release);
+    notify();
+    return true;
+  }
+  
+  // Removes the first element if queue is not empty. Returns true on success.
+  bool try_pop(T & value) {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    value = std::move(slots_[head]);
+    head_.store(advance(head), std::memory_order_release);
+    notify();
+    return true;
+  }
+  
+  // Appends element, waiting while queue is full.
+  void push(T value) {
+    while (!try_push(value)) {
+      wait([this] { 
+        return advance(tail_.load()) != head_.load(); 
+      });
+    }
+  }
+  
+  // Removes the first element, waiting while queue is empty.
+  T pop() {
+    T value;
+    while (!try_pop(value)) {
+      wait([this] { 
+        return head_.load() != tail_.load(); 
+      });
+    }
+    return value;
+  }
+  
+private:
+  std::size_t advance(std::size_t index) const {
+    return index + 1 == slots_.size() ? 0 : index + 1;
+  }
+  
+  template <typename Predicate>
+  void wait(Predicate ready) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    waiters_.fetch_add(1);
+    while (!ready()) {
+      changed_.wait(lock);
+    }
+    waiters_.fetch_sub(1);
+  }
+  
+  void notify() {
+    // Pairs with increment of waiters, so that either waiting side observes
+    // the change, or this side observes the waiter.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_relaxed) > 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      changed_.notify_all();
+    }
+  }
+  
+private:
+  std::vector<T> slots_;
+  // Index of the next element to pop, written only by consumer.
+  alignas(64) std::atomic<std::size_t> head_;
+  // Index of the next slot to push into, written only by producer.
+  alignas(64) std::atomic<std::size_t> tail_;
+  alignas(64) std::atomic<int> waiters_;
+  std::mutex mutex_;
+  std::condition_variable changed_;
+};
+
+}
+
+#endif
@@ -0,0 +1,57 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/spsc_queue.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>
+
+using namespace fsb;
+
+namespace {
+
+TEST(spsc_queue_test, bounded) {
+  spsc_queue<int> queue(2);
+  int value = 1;
+  ASSERT_TRUE(queue.try_push(value));
+  value = 2;
+  ASSERT_TRUE(queue.try_push(value));
+  value = 3;
+  ASSERT_FALSE(queue.try_push(value));
+  
+  ASSERT_TRUE(queue.try_pop(value));
+  ASSERT_EQ(1, value);
+  ASSERT_EQ(2, queue.pop());
+  ASSERT_FALSE(queue.try_pop(value));
+}
+
+TEST(spsc_queue_test, hands_over_elements_in_order) {
+  spsc_queue<std::unique_ptr<int>> queue(3);
+  const int count = 100000;
+  std::thread producer([&] {
+    for (int i = 0; i != count; ++i) {
+      queue.push(std::unique_ptr<int>(new int(i)));
+    }
+    queue.push(nullptr);
+  });
+  
+  int expected = 0;
+  while (std::unique_ptr<int> value = queue.pop()) {
+    ASSERT_EQ(expected++, *value);
+  }
+  ASSERT_EQ(count, expected);
+  producer.join();
+}
+
+}
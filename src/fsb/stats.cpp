@@ -0,0 +1,187 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/stats.hpp"
+
+#include <iomanip>
+#include <ostream>
+
+namespace fsb { namespace stats {
+
+namespace detail {
+std::atomic<bool> enabled {false};
+std::atomic<std::uint64_t> counters[static_cast<int>(counter::count)];
+}
+
+namespace {
+
+typedef std::chrono::steady_clock clock;
+
+std::atomic<std::uint64_t> stage_times[static_cast<int>(stage::count)];
+clock::time_point enabled_time;
+
+// Stage that is currently timed in this thread, and when it was entered or 
+// resumed. Stage count means that no stage is timed.
+thread_local stage current_stage = stage::count;
+thread_local clock::time_point current_start;
+
+// Adds time since current stage was entered or resumed to that stage.
+void account(clock::time_point now) {
+  if (current_stage != stage::count) {
+    const auto elapsed = 
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now - current_start);
+    stage_times[static_cast<int>(current_stage)].fetch_add(
+      elapsed.count(), std::memory_order_relaxed);
+  }
+  current_start = now;
+}
+
+const int counter_count = static_cast<int>(counter::count);
+const int stage_count = static_cast<int>(stage::count);
+
+double seconds(std::chrono::nanoseconds duration) {
+  return std::chrono::duration<double>(duration).count();
+}
+
+}
+
+const char * name(counter counter) {
+  switch (counter) {
+    case counter::bytes_decrypted: return "bytes_decrypted";
+    case counter::bytes_written:   return "bytes_written";
+    case counter::samples:         return "samples";
+    case counter::packets:         return "packets";
+    case counter::pages:           return "pages";
+    case counter::header_hits:     return "header_hits";
+    case counter::header_misses:   return "header_misses";
+    default:                       return "unknown";
+  }
+}
+
+const char * name(stage stage) {
+  switch (stage) {
+    case stage::read:          return "read";
+    case stage::decrypt:       return "decrypt";
+    case stage::parse:         return "parse";
+    case stage::header_lookup: return "header_lookup";
+    case stage::mux:           return "mux";
+    case stage::decode:        return "decode";
+    case stage::write:         return "write";
+    default:                   return "unknown";
+  }
+}
+
+void enable() {
+  enabled_time = clock::now();
+  detail::enabled.store(true);
+}
+
+void disable() {
+  detail::enabled.store(false);
+}
+
+void scoped_timer::start(stage stage) {
+  account(clock::now());
+  parent_ = current_stage;
+  current_stage = stage;
+}
+
+void scoped_timer::stop() {
+  account(clock::now());
+  current_stage = parent_;
+}
+
+snapshot collect() {
+  snapshot snapshot;
+  for (int i = 0; i < counter_count; ++i) {
+    snapshot.counters[i] = detail::counters[i].load();
+  }
+  for (int i = 0; i < stage_count; ++i) {
+    snapshot.stages[i] = std::chrono::nanoseconds(stage_times[i].load());
+  }
+  snapshot.wall_time = enabled() ?
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      clock::now() - enabled_time) : std::chrono::nanoseconds(0);
+  return snapshot;
+}
+
+void write_table(std::ostream & stream, const snapshot & snapshot) {
+  std::chrono::nanoseconds total(0);
+  for (const auto & time : snapshot.stages) {
+    total += time;
+  }
+  
+  stream 
+    << std::left << std::setw(16) << "stage" << std::right
+    << std::setw(12) << "seconds" << std::setw(8) << "share" << '\n'
+    << std::fixed << std::setprecision(3);
+  for (int i = 0; i < stage_count; ++i) {
+    const double share = total.count() ? 
+      100.0 * snapshot.stages[i].count() / total.count() : 0.0;
+    stream 
+      << std::left << std::setw(16) << name(static_cast<stage>(i)) 
+      << std::right << std::setw(12) << seconds(snapshot.stages[i]) 
+      << std::setw(7) << std::setprecision(1) << share << '%' 
+      << std::setprecision(3) << '\n';
+  }
+  stream 
+    << std::left << std::setw(16) << "wall time" << std::right
+    << std::setw(12) << seconds(snapshot.wall_time) << "\n\n";
+  
+  stream << std::left << std::setw(16) << "counter" << std::right
+    << std::setw(20) << "value" << '\n';
+  for (int i = 0; i < counter_count; ++i) {
+    stream 
+      << std::left << std::setw(16) << name(static_cast<counter>(i)) 
+      << std::right << std::setw(20) << snapshot.counters[i] << '\n';
+  }
+}
+
+void write_json(std::ostream & stream, const snapshot & snapshot) {
+  stream << "{\"wall_seconds\":" << seconds(snapshot.wall_time);
+  stream << ",\"stage_seconds\":{";
+  for (int i = 0; i < stage_count; ++i) {
+    stream 
+      << (i ? "," : "") << '"' << name(static_cast<stage>(i)) << "\":" 
+      << seconds(snapshot.stages[i]);
+  }
+  stream << "},\"counters\":{";
+  for (int i = 0; i < counter_count; ++i) {
+    stream 
+      << (i ? "," : "") << '"' << name(static_cast<counter>(i)) << "\":" 
+      << snapshot.counters[i];
+  }
+  stream << "}}\n";
+}
+
+void write_prometheus(std::ostream & stream, const snapshot & snapshot) {
+  stream 
+    << "# HELP fsb_stage_seconds_total Time spent in extraction stage.\n"
+    << "# TYPE fsb_stage_seconds_total counter\n";
+  for (int i = 0; i < stage_count; ++i) {
+    stream 
+      << "fsb_stage_seconds_total{stage=\"" << name(static_cast<stage>(i)) 
+      << "\"} " << seconds(snapshot.stages[i]) << '\n';
+  }
+  stream
+    << "# HELP fsb_wall_seconds Duration of extraction.\n"
+    << "# TYPE fsb_wall_seconds gauge\n"
+    << "fsb_wall_seconds " << seconds(snapshot.wall_time) << '\n';
+  for (int i = 0; i < counter_count; ++i) {
+    const char * const counter_name = name(static_cast<counter>(i));
+    stream 
+      << "# TYPE fsb_" << counter_name << "_total counter\n"
+      << "fsb_" << counter_name << "_total " << snapshot.counters[i] << '\n';
+  }
+}
+
+}}
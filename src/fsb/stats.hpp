@@ -0,0 +1,130 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_STATS_HPP
+#define FSB_STATS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+namespace fsb { namespace stats {
+
+// Events counted during extraction.
+enum class counter {
+  bytes_decrypted,
+  bytes_written,
+  samples,
+  packets,
+  pages,
+  header_hits,
+  header_misses,
+  count,
+};
+
+// Stages of extraction. Time of nested stages is not included in time of 
+// enclosing stage, e.g. muxing does not include writing of Ogg pages, and
+// reading or parsing does not include decryption.
+enum class stage {
+  read,
+  decrypt,
+  parse,
+  header_lookup,
+  mux,
+  decode,
+  write,
+  count,
+};
+
+// Returns name of a counter.
+const char * name(counter counter);
+
+// Returns name of a stage.
+const char * name(stage stage);
+
+namespace detail {
+extern std::atomic<bool> enabled;
+extern std::atomic<std::uint64_t> counters[static_cast<int>(counter::count)];
+}
+
+// Enables collection of statistics. Should be called before any work starts.
+void enable();
+
+// Stops collection of statistics. Values collected so far are kept.
+void disable();
+
+// Returns true if statistics are collected.
+inline bool enabled() {
+  return detail::enabled.load(std::memory_order_relaxed);
+}
+
+// Adds value to a counter.
+inline void add(counter counter, std::uint64_t value = 1) {
+  if (enabled()) {
+    detail::counters[static_cast<int>(counter)].fetch_add(
+      value, std::memory_order_relaxed);
+  }
+}
+
+// Attributes time until its destruction to a given stage. Timers can be 
+// nested within a thread, then enclosing stage is paused.
+class scoped_timer {
+  scoped_timer(const scoped_timer &) = delete;
+  scoped_timer & operator=(const scoped_timer &) = delete;
+public:
+  explicit scoped_timer(stage stage) 
+    : active_(enabled()) {
+    if (active_) {
+      start(stage);
+    }
+  }
+  
+  ~scoped_timer() {
+    if (active_) {
+      stop();
+    }
+  }
+  
+private:
+  void start(stage stage);
+  void stop();
+  
+private:
+  bool active_;
+  stage parent_;
+};
+
+// Statistics collected so far.
+struct snapshot {
+  std::uint64_t counters[static_cast<int>(counter::count)];
+  // Time spent in each stage summed over all threads.
+  std::chrono::nanoseconds stages[static_cast<int>(stage::count)];
+  // Time since statistics were enabled.
+  std::chrono::nanoseconds wall_time;
+};
+
+// Returns statistics collected so far.
+snapshot collect();
+
+// Writes statistics as human readable table.
+void write_table(std::ostream & stream, const snapshot & snapshot);
+
+// Writes statistics as JSON object.
+void write_json(std::ostream & stream, const snapshot & snapshot);
+
+// Writes statistics in Prometheus text exposition format.
+void write_prometheus(std::ostream & stream, const snapshot & snapshot);
+
+}}
+
+#endif
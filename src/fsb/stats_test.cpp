@@ -0,0 +1,79 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/stats.hpp"
+#include "fsb/test_support.hpp"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+
+using namespace fsb;
+
+namespace {
+
+TEST(stats_test, counters) {
+  test::scoped_enable enable(stats::enabled, stats::enable, stats::disable);
+  const stats::snapshot before = stats::collect();
+  stats::add(stats::counter::packets, 3);
+  stats::add(stats::counter::packets);
+  const stats::snapshot after = stats::collect();
+  
+  const int packets = static_cast<int>(stats::counter::packets);
+  ASSERT_EQ(4u, after.counters[packets] - before.counters[packets]);
+}
+
+TEST(stats_test, nested_stages_are_exclusive) {
+  test::scoped_enable enable(stats::enabled, stats::enable, stats::disable);
+  const int mux = static_cast<int>(stats::stage::mux);
+  const int write = static_cast<int>(stats::stage::write);
+  const stats::snapshot before = stats::collect();
+  {
+    stats::scoped_timer outer(stats::stage::mux);
+    {
+      stats::scoped_timer inner(stats::stage::write);
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+  }
+  const stats::snapshot after = stats::collect();
+  
+  const auto mux_time = after.stages[mux] - before.stages[mux];
+  const auto write_time = after.stages[write] - before.stages[write];
+  ASSERT_LE(std::chrono::milliseconds(20), write_time);
+  ASSERT_GT(std::chrono::milliseconds(10), mux_time);
+}
+
+TEST(stats_test, write_json) {
+  stats::snapshot snapshot {};
+  snapshot.counters[static_cast<int>(stats::counter::pages)] = 7;
+  snapshot.stages[static_cast<int>(stats::stage::read)] = 
+    std::chrono::milliseconds(500);
+  
+  std::ostringstream stream;
+  stats::write_json(stream, snapshot);
+  const std::string json = stream.str();
+  ASSERT_NE(std::string::npos, json.find("\"pages\":7"));
+  ASSERT_NE(std::string::npos, json.find("\"read\":0.5"));
+}
+
+TEST(stats_test, write_prometheus) {
+  stats::snapshot snapshot {};
+  snapshot.counters[static_cast<int>(stats::counter::header_misses)] = 2;
+  
+  std::ostringstream stream;
+  stats::write_prometheus(stream, snapshot);
+  ASSERT_NE(std::string::npos, 
+    stream.str().find("\nfsb_header_misses_total 2\n"));
+}
+
+}
@@ -0,0 +1,44 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_TEST_SUPPORT_HPP
+#define FSB_TEST_SUPPORT_HPP
+
+namespace fsb { namespace test {
+
+// Enables statistics or tracing for the duration of a test, then restores 
+// previous state. Takes functions of the module, e.g. stats::enabled, 
+// stats::enable and stats::disable.
+class scoped_enable {
+  scoped_enable(const scoped_enable &) = delete;
+  scoped_enable & operator=(const scoped_enable &) = delete;
+  
+public:
+  scoped_enable(bool (&enabled)(), void (&enable)(), void (&disable)())
+    : disable_(disable), was_enabled_(enabled()) {
+    enable();
+  }
+  
+  ~scoped_enable() {
+    if (!was_enabled_) {
+      disable_();
+    }
+  }
+  
+private:
+  void (&disable_)();
+  const bool was_enabled_;
+};
+
+}}
+
+#endif
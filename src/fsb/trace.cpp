@@ -0,0 +1,163 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace fsb { namespace trace {
+
+namespace detail {
+std::atomic<bool> enabled {false};
+}
+
+namespace {
+
+typedef std::chrono::steady_clock clock;
+
+struct event {
+  const char * name;
+  // Detail is copied into event, so that recording does not allocate.
+  char detail[64];
+  std::uint8_t detail_size;
+  // Start and duration in nanoseconds since tracing was enabled.
+  std::int64_t start;
+  std::int64_t duration;
+};
+
+// Spans recorded by a single thread.
+struct thread_buffer {
+  explicit thread_buffer(int id)
+    : id(id) {
+    events.reserve(4096);
+  }
+  
+  const int id;
+  std::vector<event> events;
+};
+
+clock::time_point enabled_time;
+
+// Buffers of all threads. They outlive threads, so that spans can be written
+// after workers finish.
+std::mutex buffers_mutex;
+std::vector<std::unique_ptr<thread_buffer>> buffers;
+
+thread_local thread_buffer * current_buffer = nullptr;
+
+// Returns buffer of the current thread, registering it on first use.
+thread_buffer & this_thread_buffer() {
+  if (!current_buffer) {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    buffers.emplace_back(new thread_buffer(buffers.size() + 1));
+    current_buffer = buffers.back().get();
+  }
+  return *current_buffer;
+}
+
+std::int64_t now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    clock::now() - enabled_time).count();
+}
+
+// Writes string as JSON string literal.
+void write_string(std::ostream & stream, boost::string_ref value) {
+  static const char hex[] = "0123456789abcdef";
+  stream << '"';
+  for (const char c : value) {
+    const unsigned char u = static_cast<unsigned char>(c);
+    if (c == '"' || c == '\\') {
+      stream << '\\' << c;
+    } else if (u < 0x20) {
+      stream << "\\u00" << hex[u >> 4u] << hex[u & 15u];
+    } else {
+      stream << c;
+    }
+  }
+  stream << '"';
+}
+
+// Writes time in microseconds, used by trace event format.
+void write_time(std::ostream & stream, std::int64_t nanoseconds) {
+  stream << nanoseconds / 1000 << '.' 
+    << static_cast<char>('0' + nanoseconds / 100 % 10)
+    << static_cast<char>('0' + nanoseconds / 10 % 10)
+    << static_cast<char>('0' + nanoseconds % 10);
+}
+
+}
+
+void enable() {
+  enabled_time = clock::now();
+  detail::enabled.store(true);
+}
+
+void disable() {
+  detail::enabled.store(false);
+}
+
+void scoped_span::start(boost::string_ref detail) {
+  thread_buffer & buffer = this_thread_buffer();
+  index_ = buffer.events.size();
+  buffer.events.emplace_back();
+  event & event = buffer.events.back();
+  event.name = name_;
+  event.detail_size = static_cast<std::uint8_t>(
+    std::min(detail.size(), sizeof(event.detail)));
+  std::copy(detail.begin(), detail.begin() + event.detail_size, event.detail);
+  event.duration = 0;
+  event.start = now();
+}
+
+void scoped_span::stop() {
+  event & event = this_thread_buffer().events[index_];
+  event.duration = now() - event.start;
+}
+
+void write_json(std::ostream & stream) {
+  std::lock_guard<std::mutex> lock(buffers_mutex);
+  
+  stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for (const auto & buffer : buffers) {
+    stream 
+      << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\","
+      << "\"pid\":1,\"tid\":" << buffer->id << ",\"args\":{\"name\":\""
+      << "thread " << buffer->id << "\"}}";
+    first = false;
+    
+    for (const auto & event : buffer->events) {
+      stream << ",\n{\"name\":";
+      write_string(stream, event.name);
+      stream << ",\"cat\":\"fsb\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id;
+      stream << ",\"ts\":";
+      write_time(stream, event.start);
+      stream << ",\"dur\":";
+      write_time(stream, event.duration);
+      if (event.detail_size) {
+        stream << ",\"args\":{\"detail\":";
+        write_string(stream, 
+          boost::string_ref(event.detail, event.detail_size));
+        stream << '}';
+      }
+      stream << '}';
+    }
+  }
+  stream << "\n]}\n";
+}
+
+}}
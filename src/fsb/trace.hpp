@@ -0,0 +1,78 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_TRACE_HPP
+#define FSB_TRACE_HPP
+
+#include <boost/utility/string_ref.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace fsb { namespace trace {
+
+namespace detail {
+extern std::atomic<bool> enabled;
+}
+
+// Enables recording of spans. Should be called before any work starts.
+void enable();
+
+// Stops recording of spans. Spans recorded so far are kept.
+void disable();
+
+// Returns true if spans are recorded.
+inline bool enabled() {
+  return detail::enabled.load(std::memory_order_relaxed);
+}
+
+// Records a span from its construction until its destruction. 
+//
+// Spans are appended to a buffer owned by the current thread, so recording 
+// does not synchronize with other threads.
+class scoped_span {
+  scoped_span(const scoped_span &) = delete;
+  scoped_span & operator=(const scoped_span &) = delete;
+public:
+  // Name must be a string literal, detail is shown as span argument. Detail
+  // is copied without allocation, and truncated if it is long.
+  explicit scoped_span(const char * name, boost::string_ref detail = "")
+    : name_(enabled() ? name : nullptr) {
+    if (name_) {
+      start(detail);
+    }
+  }
+  
+  ~scoped_span() {
+    if (name_) {
+      stop();
+    }
+  }
+  
+private:
+  void start(boost::string_ref detail);
+  void stop();
+  
+private:
+  const char * name_;
+  std::size_t index_;
+};
+
+// Writes spans recorded so far in Chrome trace event format. Threads that 
+// record spans must not run concurrently.
+void write_json(std::ostream & stream);
+
+}}
+
+#endif
@@ -0,0 +1,50 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/trace.hpp"
+#include "fsb/test_support.hpp"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+
+using namespace fsb;
+
+namespace {
+
+TEST(trace_test, spans_of_threads) {
+  test::scoped_enable enable(trace::enabled, trace::enable, trace::disable);
+  {
+    trace::scoped_span span("outer", "quoted \"detail\"");
+    trace::scoped_span long_span("long", std::string(100, 'x'));
+    std::thread thread([] {
+      trace::scoped_span span("inner");
+    });
+    thread.join();
+  }
+  
+  std::ostringstream stream;
+  trace::write_json(stream);
+  const std::string json = stream.str();
+  ASSERT_NE(std::string::npos, json.find("\"name\":\"outer\""));
+  ASSERT_NE(std::string::npos, json.find("\"name\":\"inner\""));
+  ASSERT_NE(std::string::npos, json.find("\"detail\":\"quoted \\\"detail\\\"\""));
+  ASSERT_NE(std::string::npos, json.find("\"tid\":2"));
+  // Long details are truncated.
+  ASSERT_NE(std::string::npos, 
+    json.find("\"detail\":\"" + std::string(64, 'x') + "\""));
+  ASSERT_EQ(std::string::npos, json.find(std::string(65, 'x')));
+  ASSERT_EQ("\n]}\n", json.substr(json.size() - 4));
+}
+
+}
@@ -0,0 +1,184 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/vorbis/decoder.hpp"
+
+#include "fsb/error.hpp"
+#include "fsb/stats.hpp"
+#include "fsb/vorbis/rebuilder.hpp"
+
+#include <cmath>
+#include <string>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace fsb { namespace vorbis {
+
+namespace {
+
+// Initializes synthesis state and block for decoding. Throws error if 
+// libvorbis rejects given info, leaving nothing to clear.
+void synthesis_init(
+  vorbis_dsp_state & dsp_state, vorbis_block & block, vorbis_info & info) {
+  int result = vorbis_synthesis_init(&dsp_state, &info);
+  if (result != 0) {
+    throw error("vorbis_synthesis_init failed: " + std::to_string(result));
+  }
+  result = vorbis_block_init(&dsp_state, &block);
+  if (result != 0) {
+    vorbis_dsp_clear(&dsp_state);
+    throw error("vorbis_block_init failed: " + std::to_string(result));
+  }
+}
+
+}
+
+decoder::decoder(const sample & sample) {
+  ogg_packet_holder header_id;
+  ogg_packet_holder header_comment;
+  ogg_packet_holder header_setup;
+  
+  rebuilder::rebuild_headers(
+    sample.channels, sample.frequency, sample.vorbis_crc32,
+    sample.loop_start, sample.loop_end,
+    header_id, header_comment, header_setup);
+  
+  synthesis_headerin(info_, comment_, header_id);
+  synthesis_headerin(info_, comment_, header_comment);
+  synthesis_headerin(info_, comment_, header_setup);
+  
+  synthesis_init(dsp_state_, block_, info_);
+}
+
+decoder::~decoder() {
+  vorbis_block_clear(&block_);
+  vorbis_dsp_clear(&dsp_state_);
+}
+
+void decoder::decode(
+  io::buffer_view sample_view, std::vector<std::int16_t> & output) {
+  
+  stats::scoped_timer timer(stats::stage::decode);
+  const int channels = info_->channels;
+  ogg_int64_t packetno = 3;
+  
+  std::uint16_t packet_size = sample_view.read<std::uint16_t>();
+  while (packet_size) {
+    ogg_packet packet {};
+    packet.packet = 
+      reinterpret_cast<unsigned char*>(
+        const_cast<char*>(sample_view.read(packet_size)));
+    packet.bytes = packet_size;
+    packet.packetno = packetno++;
+    packet.granulepos = -1;
+    
+    packet_size = sample_view.offset() + 2 < sample_view.size() ?
+      sample_view.read<std::uint16_t>() : 0;
+    packet.e_o_s = packet_size ? 0 : 1;
+    
+    const int result = vorbis_synthesis(&block_, &packet);
+    if (result != 0) {
+      throw error("vorbis_synthesis failed: " + std::to_string(result));
+    }
+    const int blockin_result = vorbis_synthesis_blockin(&dsp_state_, &block_);
+    if (blockin_result != 0) {
+      throw error(
+        "vorbis_synthesis_blockin failed: " + std::to_string(blockin_result));
+    }
+    
+    float ** pcm;
+    int frames;
+    while ((frames = vorbis_synthesis_pcmout(&dsp_state_, &pcm)) > 0) {
+      // Interleave channels, then convert all samples at once.
+      interleaved_.resize(std::size_t(frames) * channels);
+      for (int channel = 0; channel < channels; ++channel) {
+        const float * const input = pcm[channel];
+        float * const interleaved = interleaved_.data() + channel;
+        for (int frame = 0; frame < frames; ++frame) {
+          interleaved[frame * channels] = input[frame];
+        }
+      }
+      
+      const std::size_t position = output.size();
+      output.resize(position + interleaved_.size());
+      float_to_int16(
+        interleaved_.data(), interleaved_.size(), output.data() + position);
+      
+      if (vorbis_synthesis_read(&dsp_state_, frames) != 0) {
+        throw error("vorbis_synthesis_read failed.");
+      }
+    }
+  }
+}
+
+packet_verifier::packet_verifier(const sample & sample) {
+  ogg_packet_holder header_id;
+  ogg_packet_holder header_comment;
+  ogg_packet_holder header_setup;
+  
+  rebuilder::rebuild_headers(
+    sample.channels, sample.frequency, sample.vorbis_crc32,
+    sample.loop_start, sample.loop_end,
+    header_id, header_comment, header_setup);
+  
+  synthesis_headerin(info_, comment_, header_id);
+  synthesis_headerin(info_, comment_, header_comment);
+  synthesis_headerin(info_, comment_, header_setup);
+  
+  synthesis_init(dsp_state_, block_, info_);
+}
+
+packet_verifier::~packet_verifier() {
+  vorbis_block_clear(&block_);
+  vorbis_dsp_clear(&dsp_state_);
+}
+
+bool packet_verifier::verify(ogg_packet & packet) {
+  return vorbis_synthesis(&block_, &packet) == 0;
+}
+
+void float_to_int16(
+  const float * input, std::size_t size, std::int16_t * output) {
+  std::size_t i = 0;
+
+#ifdef __SSE2__
+  // Converts eight samples at once. Samples are clamped before conversion, so
+  // that they cannot overflow 32-bit integers. Conversion rounds to nearest, 
+  // and packing saturates results to 16-bit range.
+  const __m128 scale = _mm_set1_ps(32768.0f);
+  const __m128 min = _mm_set1_ps(-32768.0f);
+  const __m128 max = _mm_set1_ps(32767.0f);
+  for (; i + 8 <= size; i += 8) {
+    const __m128 a = _mm_max_ps(min, _mm_min_ps(max,
+      _mm_mul_ps(_mm_loadu_ps(input + i), scale)));
+    const __m128 b = _mm_max_ps(min, _mm_min_ps(max,
+      _mm_mul_ps(_mm_loadu_ps(input + i + 4), scale)));
+    const __m128i packed = 
+      _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), packed);
+  }
+#endif
+
+  for (; i < size; ++i) {
+    float x = input[i] * 32768.0f;
+    if (x > 32767.0f) {
+      x = 32767.0f;
+    } else if (x < -32768.0f) {
+      x = -32768.0f;
+    }
+    output[i] = static_cast<std::int16_t>(std::lrint(x));
+  }
+}
+
+}}
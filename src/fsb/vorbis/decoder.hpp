@@ -0,0 +1,82 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_VORBIS_DECODER_HPP
+#define FSB_VORBIS_DECODER_HPP
+
+#include "fsb/io/buffer_view.hpp"
+#include "fsb/vorbis/vorbis.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fsb { namespace vorbis {
+
+// Decodes audio packets of a sample to PCM.
+// 
+// Packets are passed to libvorbis directly as they are read from sample data, 
+// without going through Ogg stream.
+class decoder {
+  decoder(const decoder &) = delete;
+  decoder & operator=(const decoder &) = delete;
+public:
+  // Initializes decoder with rebuilt Vorbis headers of a sample. Throws error
+  // if headers are rejected by libvorbis.
+  explicit decoder(const sample & sample);
+  ~decoder();
+  
+  // Decodes all audio packets of a sample and appends interleaved 16-bit PCM
+  // samples to output. Throws error if a packet cannot be decoded.
+  void decode(
+    io::buffer_view sample_view, std::vector<std::int16_t> & output);
+  
+private:
+  vorbis_info_holder info_;
+  vorbis_comment_holder comment_;
+  vorbis_dsp_state dsp_state_;
+  vorbis_block block_;
+  // Interleaved floating point samples awaiting conversion.
+  std::vector<float> interleaved_;
+};
+
+// Checks that audio packets can be decoded, without producing PCM.
+//
+// Decoding of a packet does not depend on previous packets, so a verifier 
+// can be shared by all samples with the same headers.
+class packet_verifier {
+  packet_verifier(const packet_verifier &) = delete;
+  packet_verifier & operator=(const packet_verifier &) = delete;
+public:
+  // Initializes verifier with rebuilt Vorbis headers of a sample. Throws 
+  // error if headers are rejected by libvorbis.
+  explicit packet_verifier(const sample & sample);
+  ~packet_verifier();
+  
+  // Returns true if packet was decoded successfully.
+  bool verify(ogg_packet & packet);
+  
+private:
+  vorbis_info_holder info_;
+  vorbis_comment_holder comment_;
+  vorbis_dsp_state dsp_state_;
+  vorbis_block block_;
+};
+
+// Converts floating point samples in range [-1, 1] to 16-bit integers. 
+// Samples outside of range are clipped.
+void float_to_int16(
+  const float * input, std::size_t size, std::int16_t * output);
+
+}}
+
+#endif
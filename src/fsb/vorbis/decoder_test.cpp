@@ -0,0 +1,38 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#include "fsb/vorbis/decoder.hpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace fsb::vorbis;
+
+namespace {
+
+TEST(float_to_int16_test, converts_and_clips) {
+  // More than eight samples to cover both vectorized and scalar conversion.
+  const std::vector<float> input {
+    0.0f, 0.5f, -0.5f, 1.0f, -1.0f, 2.0f, -2.0f, 1e10f,
+    -1e10f, 0.25f, -0.25f};
+  std::vector<std::int16_t> output(input.size());
+  
+  float_to_int16(input.data(), input.size(), output.data());
+  
+  const std::vector<std::int16_t> expected {
+    0, 16384, -16384, 32767, -32768, 32767, -32768, 32767,
+    -32768, 8192, -8192};
+  ASSERT_EQ(expected, output);
+}
+
+}
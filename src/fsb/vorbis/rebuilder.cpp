@@ -12,81 +12,280 @@
 //
 #include "fsb/vorbis/rebuilder.hpp"
 
+#include "fsb/error.hpp"
+#include "fsb/stats.hpp"
+
 #include <boost/range/size.hpp>
-#include <glog/logging.h>
+
+#include <limits>
+#include <string>
 
 namespace fsb { namespace vorbis {
+
+rebuilder::rebuilder(verification verification)
+  : arena_(1024)
+  , verification_(verification) {
+}
+
+const blocksize_table & rebuilder::sample_blocksizes(const sample & sample) {
+  // Block sizes are used instead of vorbis_packet_blocksize, to avoid setting
+  // up vorbis_info for each sample. Channels and rate are a part of the key,
+  // because setup header is valid only for some numbers of channels.
+  const auto key = std::make_tuple(
+    sample.vorbis_crc32, int(sample.channels), sample.frequency);
+  auto i = blocksize_tables_.find(key);
+  if (i == blocksize_tables_.end()) {
+    i = blocksize_tables_.emplace(key, rebuild_blocksize_table(sample)).first;
+  }
+  return i->second;
+}
+
+packet_verifier & rebuilder::sample_verifier(const sample & sample) {
+  // Decoding state depends on all headers, not only the setup one.
+  auto & verifier = verifiers_[
+    std::make_tuple(sample.vorbis_crc32, int(sample.channels), 
+      sample.frequency)];
+  if (!verifier) {
+    verifier.reset(new packet_verifier(sample));
+  }
+  return *verifier;
+}
+
+void rebuilder::verify_end(
+  const sample & sample,
+  io::buffer_view sample_view,
+  std::uint64_t granulepos,
+  long blocksize) {
   
-rebuilder::rebuilder() {}
+  // Samples are padded with zeros to 32 bytes, anything else indicates that
+  // chain of packet sizes is broken.
+  for (std::size_t i = sample_view.offset(); i < sample_view.size(); ++i) {
+    if (sample_view.begin()[i] != 0) {
+      throw error("Data after the last audio packet at offset " + 
+        std::to_string(i) + ".");
+    }
+  }
+  
+  if (sample.seek_granulepos > granulepos) {
+    throw error("Seek table points past the end of sample: " +
+      std::to_string(sample.seek_granulepos) + " > " +
+      std::to_string(granulepos) + ".");
+  }
+  // Loop end may extend into the overlap of the last block.
+  if (sample.loop_end > granulepos + blocksize / 2) {
+    throw error("Loop ends past the end of sample: " +
+      std::to_string(sample.loop_end) + " > " +
+      std::to_string(granulepos) + ".");
+  }
+}
+
+rebuilder & thread_rebuilder() {
+  thread_local rebuilder rebuilder;
+  return rebuilder;
+}
 
 void rebuilder::rebuild(
   const sample & sample,
   io::buffer_view sample_view,
+  std::ostream & stream,
+  int serial_number) {
+  ogg_stream_.reset(serial_number, stream);
+  rebuild_from(ogg_stream_, sample, sample_view, 
+    std::numeric_limits<std::size_t>::max(), checkpoint(), nullptr);
+}
+
+void rebuilder::rebuild_segments(
+  const sample & sample,
+  io::buffer_view sample_view,
+  std::size_t segment_size,
+  std::ostream & stream,
+  std::vector<checkpoint> & checkpoints) {
+  ogg_stream_.reset(1, stream);
+  rebuild_from(
+    ogg_stream_, sample, sample_view, segment_size, checkpoint(), &checkpoints);
+}
+
+std::uint64_t rebuilder::layout_segments(
+  const sample & sample,
+  io::buffer_view sample_view,
+  std::size_t segment_size,
+  std::vector<checkpoint> & checkpoints) {
+  ogg_layout_.reset();
+  rebuild_from(
+    ogg_layout_, sample, sample_view, segment_size, checkpoint(), &checkpoints);
+  return ogg_layout_.bytes_written();
+}
+
+void rebuilder::rebuild_segment(
+  const sample & sample,
+  io::buffer_view sample_view,
+  std::size_t segment_size,
+  const checkpoint & start,
   std::ostream & stream) {
+  if (start.output_offset == 0) {
+    ogg_stream_.reset(1, stream);
+  } else {
+    ogg_stream_.resume(1, stream, start.page_number);
+  }
+  rebuild_from(
+    ogg_stream_, sample, sample_view, segment_size, start, nullptr);
+}
+
+template <typename OggStream>
+void rebuilder::rebuild_from(
+  OggStream & ogg_stream,
+  const sample & sample,
+  io::buffer_view sample_view,
+  std::size_t segment_size,
+  const checkpoint & start,
+  std::vector<checkpoint> * checkpoints) {
   
-  vorbis_info_holder info;
-  vorbis_comment_holder comment;
+  stats::scoped_timer timer(stats::stage::mux);
+  arena_.reset();
   
-  long prev_blocksize = 0;
-  ogg_int64_t prev_granulepos = 0;
-  ogg_int64_t prev_packetno = 0;
+  // Headers are validated by libvorbis when block sizes table is built.
+  const blocksize_table & blocksizes = sample_blocksizes(sample);
+  packet_verifier * const verifier = verification_ == verification::full ?
+    &sample_verifier(sample) : nullptr;
   
-  ogg_ostream ogg_stream(1, stream);
+  checkpoint state = start;
   
-  {
+  if (start.output_offset == 0) {
     // Reconstruct and write Vorbis headers to stream.
-    ogg_packet_holder header_id;
-    ogg_packet_holder header_comment;
-    ogg_packet_holder header_setup;
+    ogg_packet header_id;
+    ogg_packet header_comment;
+    ogg_packet header_setup;
 
     rebuild_headers(
       sample.channels, sample.frequency, sample.vorbis_crc32,
       sample.loop_start, sample.loop_end,
-      header_id, header_comment, header_setup);
-    
-    CHECK(vorbis_synthesis_headerin(info, comment, header_id) == 0);
-    CHECK(vorbis_synthesis_headerin(info, comment, header_comment) == 0);
-    CHECK(vorbis_synthesis_headerin(info, comment, header_setup) == 0);
+      arena_, header_id, header_comment, header_setup);
     
     ogg_stream.write_packet(header_id);
     ogg_stream.write_packet(header_comment);
     ogg_stream.write_packet(header_setup);
     ogg_stream.flush_packets();
     
-    prev_packetno = header_setup->packetno;
-    prev_granulepos = 0;
+    state = checkpoint();
+    state.packet_number = header_setup.packetno;
+  } else {
+    sample_view.set_offset(start.input_offset);
   }
 
   {
     // Reconstruct audio packets.
-    std::uint16_t packet_size = sample_view.read_uint16();
+    std::uint64_t packets = 0;
+    // Size of audio packets written since the last flush.
+    std::size_t buffered = 0;
+    std::uint16_t packet_size = sample_view.read<std::uint16_t>();
     while (packet_size) {
       ogg_packet packet {};
       packet.packet = 
         reinterpret_cast<unsigned char*>(
           const_cast<char*>(sample_view.read(packet_size)));
       packet.bytes = packet_size;
-      packet.packetno = prev_packetno + 1;
+      packet.packetno = state.packet_number + 1;
       packet.granulepos = -1;
+      buffered += packet_size;
       
       // Read size of next packet to determine if we reached end of stream.
       packet_size = sample_view.offset() + 2 < sample_view.size() ?
-        sample_view.read_uint16() : 0;
+        sample_view.read<std::uint16_t>() : 0;
       packet.e_o_s = packet_size ? 0 : 1;
       
       // Update granulepos for packet.
-      const long blocksize = vorbis_packet_blocksize(info, &packet);
-      CHECK(blocksize > 0) << "vorbis_packet_blocksize failed: " << blocksize;
-      packet.granulepos = prev_blocksize ?
-        prev_granulepos + (blocksize + prev_blocksize) / 4 : 0;
+      const long blocksize = blocksizes(packet.packet[0]);
+      if (blocksize <= 0) {
+        throw error(
+          "Invalid audio packet: " + std::to_string(int(packet.packet[0])));
+      }
+      packet.granulepos = state.blocksize ?
+        state.granulepos + (blocksize + state.blocksize) / 4 : 0;
+      
+      if (verifier && !verifier->verify(packet)) {
+        throw error(
+          "Audio packet " + std::to_string(packets) + " cannot be decoded.");
+      }
       
       ogg_stream.write_packet(packet);
       
-      prev_blocksize = blocksize;
-      prev_granulepos = packet.granulepos;
-      prev_packetno = packet.packetno;
+      state.blocksize = blocksize;
+      state.granulepos = packet.granulepos;
+      state.packet_number = packet.packetno;
+      packets += 1;
+      
+      if (packet_size && buffered >= segment_size) {
+        ogg_stream.flush_packets();
+        buffered = 0;
+        state.output_offset = start.output_offset + ogg_stream.bytes_written();
+        state.input_offset = sample_view.offset() - 2;
+        state.page_number = ogg_stream.page_number();
+        if (!checkpoints) {
+          stats::add(stats::counter::packets, packets);
+          return;
+        }
+        checkpoints->push_back(state);
+      }
+    }
+    stats::add(stats::counter::packets, packets);
+  }
+  
+  if (verification_ != verification::none) {
+    verify_end(sample, sample_view, state.granulepos, state.blocksize);
+  }
+}
+
+std::uint64_t rebuilder::duration(
+  const blocksize_table & blocksizes,
+  io::buffer_view sample_view) {
+  
+  std::uint64_t granulepos = 0;
+  long prev_blocksize = 0;
+  
+  std::uint16_t packet_size = sample_view.read<std::uint16_t>();
+  while (packet_size) {
+    const unsigned char first_byte = *sample_view.read(packet_size);
+    const long blocksize = blocksizes(first_byte);
+    if (blocksize <= 0) {
+      throw error("Invalid audio packet: " + std::to_string(int(first_byte)));
+    }
+    
+    // Same granulepos computation as in rebuild.
+    if (prev_blocksize) {
+      granulepos += (blocksize + prev_blocksize) / 4;
     }
+    prev_blocksize = blocksize;
+    
+    packet_size = sample_view.offset() + 2 < sample_view.size() ?
+      sample_view.read<std::uint16_t>() : 0;
   }
+  
+  return granulepos;
+}
+
+std::uint64_t rebuilder::duration(
+  const sample & sample, io::buffer_view sample_view) {
+  return duration(sample_blocksizes(sample), sample_view);
+}
+
+blocksize_table rebuilder::rebuild_blocksize_table(const sample & sample) {
+  vorbis_info_holder info;
+  vorbis_comment_holder comment;
+  
+  ogg_packet_holder header_id;
+  ogg_packet_holder header_comment;
+  ogg_packet_holder header_setup;
+  
+  rebuild_headers(
+    sample.channels, sample.frequency, sample.vorbis_crc32,
+    sample.loop_start, sample.loop_end,
+    header_id, header_comment, header_setup);
+  
+  synthesis_headerin(info, comment, header_id);
+  synthesis_headerin(info, comment, header_comment);
+  synthesis_headerin(info, comment, header_setup);
+  
+  return blocksize_table(info);
 }
 
 namespace {
@@ -120,13 +319,44 @@ void rebuilder::rebuild_headers(
   ogg_packet_holder & comment,
   ogg_packet_holder & setup) {
   
+  arena arena(512);
+  ogg_packet packets[3];
+  rebuild_headers(
+    channels, rate, crc32, loop_start, loop_end,
+    arena, packets[0], packets[1], packets[2]);
+  
+  ogg_packet_holder * const holders[] {&id, &comment, &setup};
+  for (int i = 0; i < 3; ++i) {
+    ogg_packet_holder & holder = *holders[i];
+    holder.assign(packets[i].packet, packets[i].bytes);
+    holder->b_o_s = packets[i].b_o_s;
+    holder->e_o_s = packets[i].e_o_s;
+    holder->granulepos = packets[i].granulepos;
+    holder->packetno = packets[i].packetno;
+  }
+}
+
+void rebuilder::rebuild_headers(
+  int channels, int rate, std::uint32_t crc32,
+  std::uint32_t loop_start, std::uint32_t loop_end,
+  arena & arena,
+  ogg_packet & id,
+  ogg_packet & comment,
+  ogg_packet & setup) {
+  
+  stats::scoped_timer timer(stats::stage::header_lookup);
   const auto i =
     std::lower_bound(headers, headers_end, crc32, headers_info_crc32_less());
-  CHECK(i != headers_end && i->crc32 == crc32)
-    << "Headers with CRC-32 equal " << crc32 << " not found.";
+  if (i == headers_end || i->crc32 != crc32) {
+    stats::add(stats::counter::header_misses);
+    throw error(
+      "Headers with CRC-32 equal " + std::to_string(crc32) + " not found.");
+  }
+  stats::add(stats::counter::header_hits);
   
-  rebuild_id_header(channels, rate, i->blocksize_short, i->blocksize_long, id);
-  rebuild_comment_header(comment, loop_start, loop_end);
+  rebuild_id_header(
+    channels, rate, i->blocksize_short, i->blocksize_long, arena, id);
+  rebuild_comment_header(loop_start, loop_end, arena, comment);
   rebuild_setup_header(i->setup_header, i->setup_header_size, setup);
 }
 
@@ -134,7 +364,9 @@ namespace {
 
 // Returns ceil(log2(x)) of non-negative integer.
 int ilog2(int v) {
-  CHECK(v > 0);
+  if (v <= 0) {
+    throw error("Invalid block size: " + std::to_string(v));
+  }
 
   int result = 0;
   if (v) {
@@ -147,80 +379,159 @@ int ilog2(int v) {
   return result;
 }
 
-// Writes string to Ogg buffer as sequence of bytes.
-void oggpack_write_string(oggpack_buffer *opb, boost::string_ref str) {
-  for (auto c : str) {
-    oggpack_write(opb, c, 8);
-  }
+// Writes 32-bit integer in little endian order.
+unsigned char * write_uint32(unsigned char * out, std::uint32_t value) {
+  out[0] = static_cast<unsigned char>(value);
+  out[1] = static_cast<unsigned char>(value >> 8u);
+  out[2] = static_cast<unsigned char>(value >> 16u);
+  out[3] = static_cast<unsigned char>(value >> 24u);
+  return out + 4;
+}
+
+unsigned char * write_string(unsigned char * out, boost::string_ref str) {
+  return std::copy(str.begin(), str.end(), out);
+}
+
+// Writes comment of form TAG=value preceded by its length.
+unsigned char * write_comment(
+  unsigned char * out, boost::string_ref tag, std::uint32_t value) {
+  char digits[10];
+  char * digits_begin = digits + sizeof(digits);
+  do {
+    *--digits_begin = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value);
+  const boost::string_ref number(
+    digits_begin, digits + sizeof(digits) - digits_begin);
+  
+  out = write_uint32(out, tag.size() + 1 + number.size());
+  out = write_string(out, tag);
+  *out++ = '=';
+  return write_string(out, number);
+}
+
+// Returns vendor string written by libvorbis into comment headers.
+const std::string & vendor_string() {
+  // Comment headers are rebuilt by hand, but they are otherwise identical to 
+  // those from libvorbis, so the vendor string is taken from there once.
+  static const std::string vendor = [] {
+    vorbis_comment_holder comment;
+    ogg_packet_holder packet;
+    vorbis_commentheader_out(comment, packet);
+    // Packet type, "vorbis", vendor length and vendor string.
+    if (packet->bytes < 11) {
+      throw error("Invalid comment header.");
+    }
+    const std::uint32_t length = 
+      packet->packet[7] | packet->packet[8] << 8u |
+      packet->packet[9] << 16u | packet->packet[10] << 24u;
+    if (11 + length > std::uint64_t(packet->bytes)) {
+      throw error("Invalid comment header.");
+    }
+    return std::string(
+      reinterpret_cast<const char *>(packet->packet) + 11, length);
+  }();
+  return vendor;
 }
 
 }
 
 void rebuilder::rebuild_id_header(
   int channels, int rate, int blocksize_short, int blocksize_long, 
-  ogg_packet_holder & packet) {
+  arena & arena, ogg_packet & packet) {
+  
+  if (channels < 1 || channels > 255) {
+    throw error("Invalid number of channels: " + std::to_string(channels));
+  }
+  if (rate <= 0) {
+    throw error("Invalid sample rate: " + std::to_string(rate));
+  }
   
   // Identification header
-  oggpack_buffer opb;
-  oggpack_writeinit(&opb);
-
+  const std::size_t size = 30;
+  unsigned char * const begin = arena.allocate_array<unsigned char>(size);
+  unsigned char * out = begin;
+  
   // Preamble
-  oggpack_write(&opb, 0x01, 8);
-  oggpack_write_string(&opb, "vorbis");
-
+  *out++ = 0x01;
+  out = write_string(out, "vorbis");
+  
   // Basic information about the stream.
-  oggpack_write(&opb, 0x00, 32);
-  oggpack_write(&opb, channels, 8);
-  oggpack_write(&opb, rate, 32);
-
+  out = write_uint32(out, 0);
+  *out++ = static_cast<unsigned char>(channels);
+  out = write_uint32(out, rate);
+  
   // Bitrate upper, nominal and lower.
   // All are optional and we do not provide them.
-  oggpack_write(&opb, 0, 32);
-  oggpack_write(&opb, 0, 32);
-  oggpack_write(&opb, 0, 32);
-
-  oggpack_write(&opb, ilog2(blocksize_short), 4);
-  oggpack_write(&opb, ilog2(blocksize_long), 4);
-  oggpack_write(&opb, 1, 1);
-
-  CHECK(oggpack_writecheck(&opb) == 0);
+  out = write_uint32(out, 0);
+  out = write_uint32(out, 0);
+  out = write_uint32(out, 0);
   
-  packet.assign(opb.buffer, oggpack_bytes(&opb));
-  packet->b_o_s = 1;
-  packet->e_o_s = 0;
-  packet->granulepos = 0;
-  packet->packetno = 0;
+  // Block sizes as 4 bit exponents, and framing bit.
+  *out++ = static_cast<unsigned char>(
+    ilog2(blocksize_short) | ilog2(blocksize_long) << 4);
+  *out++ = 1;
   
-  oggpack_writeclear(&opb);
+  packet = ogg_packet {};
+  packet.packet = begin;
+  packet.bytes = size;
+  packet.b_o_s = 1;
+  packet.e_o_s = 0;
+  packet.granulepos = 0;
+  packet.packetno = 0;
 }
 
 void rebuilder::rebuild_comment_header(
-  ogg_packet_holder & packet,
-  std::uint32_t loop_start, std::uint32_t loop_end) {
-  // Comments header are generated using libvorbis for simplicity.
-  vorbis_comment_holder comment;
-  if (loop_start != 0 && loop_end != 0) {
-    const std::string s_loop_start = std::to_string(loop_start);
-    const std::string s_loop_end = std::to_string(loop_end);
-    comment.add_tag("LOOP_START", s_loop_start.c_str());
-    comment.add_tag("LOOP_END", s_loop_end.c_str());
+  std::uint32_t loop_start, std::uint32_t loop_end,
+  arena & arena, ogg_packet & packet) {
+  
+  const std::string & vendor = vendor_string();
+  const bool has_loop = loop_start != 0 && loop_end != 0;
+  
+  // Preamble, vendor, comments count, comments and framing bit. Comments are
+  // at most 10 + 1 + 10 bytes long.
+  const std::size_t max_size = 
+    7 + 4 + vendor.size() + 4 + (has_loop ? 2 * (4 + 21) : 0) + 1;
+  unsigned char * const begin = arena.allocate_array<unsigned char>(max_size);
+  unsigned char * out = begin;
+  
+  *out++ = 0x03;
+  out = write_string(out, "vorbis");
+  out = write_uint32(out, vendor.size());
+  out = write_string(out, vendor);
+  out = write_uint32(out, has_loop ? 2 : 0);
+  if (has_loop) {
+    out = write_comment(out, "LOOP_START", loop_start);
+    out = write_comment(out, "LOOP_END", loop_end);
   }
-  packet.clear();
-  vorbis_commentheader_out(comment, packet);
+  *out++ = 1;
+  
+  packet = ogg_packet {};
+  packet.packet = begin;
+  packet.bytes = out - begin;
+  packet.b_o_s = 0;
+  packet.e_o_s = 0;
+  packet.granulepos = 0;
+  packet.packetno = 1;
 }
   
 void rebuilder::rebuild_setup_header(
   const char * payload, std::size_t payload_size,
-  ogg_packet_holder & packet) {
+  ogg_packet & packet) {
   
-  CHECK(payload_size != 0) << "Empty setup header.";
+  if (payload_size == 0) {
+    throw error("Empty setup header.");
+  }
   
-  // Setup header 
-  packet.assign(payload, payload_size);
-  packet->b_o_s = 0;
-  packet->e_o_s = 0;
-  packet->granulepos = 0;
-  packet->packetno = 2;
+  // Setup header is used directly, libogg and libvorbis do not modify packets.
+  packet = ogg_packet {};
+  packet.packet = 
+    reinterpret_cast<unsigned char *>(const_cast<char *>(payload));
+  packet.bytes = payload_size;
+  packet.b_o_s = 0;
+  packet.e_o_s = 0;
+  packet.granulepos = 0;
+  packet.packetno = 2;
 }
 
 }}
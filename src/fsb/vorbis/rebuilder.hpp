@@ -13,27 +13,110 @@
 #ifndef FSB_VORBIS_REBUILDER_HPP
 #define FSB_VORBIS_REBUILDER_HPP
 
+#include "fsb/arena.hpp"
 #include "fsb/io/buffer_view.hpp"
+#include "fsb/vorbis/decoder.hpp"
 #include "fsb/vorbis/vorbis.hpp"
 
+#include <cstddef>
 #include <cstdint>
 #include <iosfwd>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
 
 namespace fsb { namespace vorbis {
 
+// Checks of samples performed while they are rebuilt.
+enum class verification {
+  // Only checks needed to rebuild a sample.
+  none,
+  // Packets must cover whole sample data, and final granule position must 
+  // agree with seek table and loop points.
+  fast,
+  // As fast, and additionally every audio packet is decoded.
+  full,
+};
+
 // Rebuilds Vorbis headers and audio data.
+//
+// Rebuilder is a long-lived session that owns Ogg stream state and scratch 
+// memory, which are reset between samples instead of being set up again. It
+// is not thread safe, and should be held by each thread that rebuilds 
+// samples.
 class rebuilder {
   rebuilder(const rebuilder &) = delete;
   rebuilder & operator=(const rebuilder &) = delete;
 public:
-  rebuilder();
+  // Position between pages of rebuilt sample, from which rebuilding can be
+  // resumed. Default constructed checkpoint is the beginning of a sample.
+  struct checkpoint {
+    // Offset within rebuilt sample.
+    std::uint64_t output_offset = 0;
+    // Offset of the next audio packet within sample data.
+    std::size_t input_offset = 0;
+    long page_number = 0;
+    ogg_int64_t packet_number = 0;
+    ogg_int64_t granulepos = 0;
+    long blocksize = 0;
+  };
+  
+  explicit rebuilder(verification verification = verification::none);
   
-  // Rebuilds sample and write it to a stream.
-  static void rebuild(
+  // Rebuilds sample and write it to a stream, as a logical bitstream with 
+  // given serial number. Throws error if sample fails verification.
+  //
+  // Once buffers grow to the size needed by samples, no allocations are made.
+  void rebuild(
     const sample & sample, 
     io::buffer_view sample_view,
+    std::ostream & stream,
+    int serial_number = 1);
+  
+  // Rebuilds sample as a sequence of segments, by flushing pages once audio 
+  // packets of at least given size were written since the previous flush. 
+  // Appends checkpoints at the beginning of every segment but the first one.
+  void rebuild_segments(
+    const sample & sample,
+    io::buffer_view sample_view,
+    std::size_t segment_size,
+    std::ostream & stream,
+    std::vector<checkpoint> & checkpoints);
+  
+  // Computes checkpoints of rebuild_segments and returns size of rebuilt
+  // sample, from sizes of packets alone. Packets are not muxed into pages, 
+  // and page checksums are not computed.
+  std::uint64_t layout_segments(
+    const sample & sample,
+    io::buffer_view sample_view,
+    std::size_t segment_size,
+    std::vector<checkpoint> & checkpoints);
+  
+  // Rebuilds a single segment of a sample beginning at given checkpoint, 
+  // which was obtained from rebuild_segments with the same segment size.
+  void rebuild_segment(
+    const sample & sample,
+    io::buffer_view sample_view,
+    std::size_t segment_size,
+    const checkpoint & start,
     std::ostream & stream);
   
+  // Returns duration of a sample as a number of PCM samples per channel.
+  // 
+  // Only sizes and first bytes of audio packets are examined, the packets are
+  // neither decoded nor muxed into Ogg stream.
+  static std::uint64_t duration(
+    const blocksize_table & blocksizes,
+    io::buffer_view sample_view);
+  
+  // Returns duration of a sample as above, with block sizes table cached by
+  // the rebuilder. Throws error if headers of a sample are invalid.
+  std::uint64_t duration(const sample & sample, io::buffer_view sample_view);
+  
+  // Rebuilds Vorbis headers of a sample and returns its block sizes table.
+  static blocksize_table rebuild_blocksize_table(const sample & sample);
+  
   // Rebuilds Vorbis headers and returns them as Ogg packets.
   static void rebuild_headers(
     int channels, int rate, std::uint32_t crc32,
@@ -42,21 +125,81 @@ public:
     ogg_packet_holder & comment,
     ogg_packet_holder & setup);
   
-  // Rebuilds identification header.
+  // Rebuilds Vorbis headers without copying them. Packets point to memory 
+  // allocated from arena, or to static table of setup headers.
+  static void rebuild_headers(
+    int channels, int rate, std::uint32_t crc32,
+    std::uint32_t loop_start, std::uint32_t loop_end,
+    arena & arena,
+    ogg_packet & id,
+    ogg_packet & comment,
+    ogg_packet & setup);
+  
+  // Rebuilds identification header in memory allocated from arena. Throws 
+  // error if number of channels or rate is out of range.
   static void rebuild_id_header(
     int channels, int rate, int blocksize_short, int blocksize_long, 
-    ogg_packet_holder & packet);
+    arena & arena, ogg_packet & packet);
   
-  // Rebuilds comment header.
+  // Rebuilds comment header in memory allocated from arena.
   static void rebuild_comment_header(
-    ogg_packet_holder & packet,
-    std::uint32_t loop_start, std::uint32_t loop_end);
+    std::uint32_t loop_start, std::uint32_t loop_end,
+    arena & arena, ogg_packet & packet);
   
-  // Rebuilds setup header.
+  // Rebuilds setup header pointing to a given payload.
   static void rebuild_setup_header(
     const char * payload, std::size_t payload_size,
-    ogg_packet_holder & packet);
+    ogg_packet & packet);
+  
+private:
+  // Rebuilds sample from a given checkpoint into Ogg stream, which is 
+  // either ogg_ostream or ogg_layout, already started or resumed. Pages are 
+  // flushed as described in rebuild_segments. Checkpoints are appended to a 
+  // given vector, or if it is null, rebuilding stops at the first one.
+  template <typename OggStream>
+  void rebuild_from(
+    OggStream & ogg_stream,
+    const sample & sample,
+    io::buffer_view sample_view,
+    std::size_t segment_size,
+    const checkpoint & start,
+    std::vector<checkpoint> * checkpoints);
+  
+  // Returns block sizes table of a sample, rebuilding it on first use. 
+  // Throws error if headers of a sample are invalid.
+  const blocksize_table & sample_blocksizes(const sample & sample);
+  
+  // Returns packet verifier for a sample, creating it on first use.
+  packet_verifier & sample_verifier(const sample & sample);
+  
+  // Checks that the rest of sample data after the last packet is padding,
+  // and that final granule position is plausible.
+  static void verify_end(
+    const sample & sample,
+    io::buffer_view sample_view,
+    std::uint64_t granulepos,
+    long blocksize);
+  
+private:
+  // Memory for rebuilt headers, reset before each sample.
+  arena arena_;
+  ogg_ostream ogg_stream_;
+  ogg_layout ogg_layout_;
+  // Block sizes tables indexed by CRC-32 of Vorbis setup header, channels 
+  // and rate. Building a table validates all headers with libvorbis, so each
+  // combination is validated once.
+  std::map<
+    std::tuple<std::uint32_t, int, std::uint32_t>, 
+    blocksize_table> blocksize_tables_;
+  const verification verification_;
+  // Packet verifiers indexed by CRC-32 of setup header, channels and rate.
+  std::map<
+    std::tuple<std::uint32_t, int, std::uint32_t>, 
+    std::unique_ptr<packet_verifier>> verifiers_;
 };
+
+// Returns rebuilder owned by the calling thread.
+rebuilder & thread_rebuilder();
   
 }}
 
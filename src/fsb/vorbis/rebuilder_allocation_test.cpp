@@ -0,0 +1,105 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// Allocation functions are replaced for the whole process, so this test is
+// built as an executable of its own, apart from other tests.
+#include "fsb/vorbis/headers_generator.hpp"
+#include "fsb/vorbis/rebuilder.hpp"
+#include "fsb/vorbis/test_support.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+using namespace fsb::vorbis;
+
+#ifdef __GLIBC__
+namespace {
+std::atomic<bool> count_allocations {false};
+std::atomic<int> allocations {0};
+}
+
+// Allocation functions are replaced to count calls made by the test, 
+// including those from libogg and libvorbis.
+extern "C" {
+void * __libc_malloc(std::size_t size);
+void * __libc_calloc(std::size_t n, std::size_t size);
+void * __libc_realloc(void * ptr, std::size_t size);
+
+void * malloc(std::size_t size) noexcept {
+  if (count_allocations) {
+    ++allocations;
+  }
+  return __libc_malloc(size);
+}
+
+void * calloc(std::size_t n, std::size_t size) noexcept {
+  if (count_allocations) {
+    ++allocations;
+  }
+  return __libc_calloc(n, size);
+}
+
+void * realloc(void * ptr, std::size_t size) noexcept {
+  if (count_allocations) {
+    ++allocations;
+  }
+  return __libc_realloc(ptr, size);
+}
+}
+
+namespace {
+
+// Stream buffer that discards output without allocating memory.
+class null_buffer : public std::streambuf {
+protected:
+  int_type overflow(int_type c) override {
+    return traits_type::not_eof(c);
+  }
+  std::streamsize xsputn(const char *, std::streamsize n) override {
+    return n;
+  }
+};
+
+TEST(rebuilder_allocation_test, rebuild_does_not_allocate_in_steady_state) {
+  headers_generator generator(2, 44100, 50);
+  fsb::sample sample;
+  sample.channels = 2;
+  sample.frequency = 44100;
+  sample.vorbis_crc32 = crc32(generator.setup_header());
+  sample.loop_start = 10;
+  sample.loop_end = 2000;
+  
+  const std::vector<char> data = make_sample_data(200, 100);
+  const fsb::io::buffer_view view(data.data(), data.size());
+  
+  null_buffer buffer;
+  std::ostream stream(&buffer);
+  rebuilder rebuilder;
+  // First sample sets up buffers that are reused later.
+  rebuilder.rebuild(sample, view, stream);
+  
+  allocations = 0;
+  count_allocations = true;
+  for (int i = 0; i < 10; ++i) {
+    rebuilder.rebuild(sample, view, stream);
+  }
+  count_allocations = false;
+  ASSERT_EQ(0, allocations);
+}
+
+}
+#endif
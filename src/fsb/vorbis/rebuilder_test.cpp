@@ -10,14 +10,17 @@
 // MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
 // GNU General Public License for more details.
 //
+#include "fsb/error.hpp"
 #include "fsb/vorbis/headers_generator.hpp"
 #include "fsb/vorbis/rebuilder.hpp"
+#include "fsb/vorbis/test_support.hpp"
 
 #include <boost/range/size.hpp>
 #include <gtest/gtest.h>
 
 #include <algorithm>
-#include <cstdlib>
+#include <ostream>
+#include <sstream>
 #include <vector>
 
 using namespace fsb::vorbis;
@@ -28,92 +31,153 @@ TEST(rebuilder_test, rebuild_id_header) {
   const int channels = 2;
   const int rate = 8000;
   
-  ogg_packet_holder op;
+  fsb::arena arena;
+  ogg_packet op;
   
   rebuilder::rebuild_id_header(
-    channels, rate, 256, 512, op);
+    channels, rate, 256, 512, arena, op);
 
-  ASSERT_EQ(30, op->bytes);
+  ASSERT_EQ(30, op.bytes);
   
   // Preamble
-  ASSERT_EQ(1, op->packet[0]);
-  ASSERT_EQ('v', op->packet[1]);
-  ASSERT_EQ('o', op->packet[2]);
-  ASSERT_EQ('r', op->packet[3]);
-  ASSERT_EQ('b', op->packet[4]);
-  ASSERT_EQ('i', op->packet[5]);
-  ASSERT_EQ('s', op->packet[6]);
-  
-  ASSERT_EQ(0, op->packet[7]);
-  ASSERT_EQ(0, op->packet[8]);
-  ASSERT_EQ(0, op->packet[9]);
-  ASSERT_EQ(0, op->packet[10]);
+  ASSERT_EQ(1, op.packet[0]);
+  ASSERT_EQ('v', op.packet[1]);
+  ASSERT_EQ('o', op.packet[2]);
+  ASSERT_EQ('r', op.packet[3]);
+  ASSERT_EQ('b', op.packet[4]);
+  ASSERT_EQ('i', op.packet[5]);
+  ASSERT_EQ('s', op.packet[6]);
+  
+  ASSERT_EQ(0, op.packet[7]);
+  ASSERT_EQ(0, op.packet[8]);
+  ASSERT_EQ(0, op.packet[9]);
+  ASSERT_EQ(0, op.packet[10]);
   
   // Channels
-  ASSERT_EQ(channels, op->packet[11]);
+  ASSERT_EQ(channels, op.packet[11]);
   
   // Rate
-  ASSERT_EQ((rate >>  0) % 256, op->packet[12]);
-  ASSERT_EQ((rate >>  8) % 256, op->packet[13]);
-  ASSERT_EQ((rate >> 16) % 256, op->packet[14]);
-  ASSERT_EQ((rate >> 24) % 256, op->packet[15]);
+  ASSERT_EQ((rate >>  0) % 256, op.packet[12]);
+  ASSERT_EQ((rate >>  8) % 256, op.packet[13]);
+  ASSERT_EQ((rate >> 16) % 256, op.packet[14]);
+  ASSERT_EQ((rate >> 24) % 256, op.packet[15]);
   
   // Bitrate upper
-  ASSERT_EQ(0, op->packet[16]);
-  ASSERT_EQ(0, op->packet[17]);
-  ASSERT_EQ(0, op->packet[18]);
-  ASSERT_EQ(0, op->packet[19]);
+  ASSERT_EQ(0, op.packet[16]);
+  ASSERT_EQ(0, op.packet[17]);
+  ASSERT_EQ(0, op.packet[18]);
+  ASSERT_EQ(0, op.packet[19]);
   
   // Bitrate nominal
-  ASSERT_EQ(0, op->packet[20]);
-  ASSERT_EQ(0, op->packet[21]);
-  ASSERT_EQ(0, op->packet[22]);
-  ASSERT_EQ(0, op->packet[23]);
+  ASSERT_EQ(0, op.packet[20]);
+  ASSERT_EQ(0, op.packet[21]);
+  ASSERT_EQ(0, op.packet[22]);
+  ASSERT_EQ(0, op.packet[23]);
   
   // Bitrate lower
-  ASSERT_EQ(0, op->packet[24]);
-  ASSERT_EQ(0, op->packet[25]);
-  ASSERT_EQ(0, op->packet[26]);
-  ASSERT_EQ(0, op->packet[27]);
+  ASSERT_EQ(0, op.packet[24]);
+  ASSERT_EQ(0, op.packet[25]);
+  ASSERT_EQ(0, op.packet[26]);
+  ASSERT_EQ(0, op.packet[27]);
   
   // Blocksizes
-  ASSERT_EQ(8 | (9 << 4), op->packet[28]);
+  ASSERT_EQ(8 | (9 << 4), op.packet[28]);
   
   // Framing
-  ASSERT_EQ(1, op->packet[29]);
+  ASSERT_EQ(1, op.packet[29]);
    
-  ASSERT_EQ(1, op->b_o_s);
-  ASSERT_EQ(0, op->e_o_s);
-  ASSERT_EQ(0, op->granulepos);
-  ASSERT_EQ(0, op->packetno);
+  ASSERT_EQ(1, op.b_o_s);
+  ASSERT_EQ(0, op.e_o_s);
+  ASSERT_EQ(0, op.granulepos);
+  ASSERT_EQ(0, op.packetno);
+}
+
+TEST(rebuilder_test, rebuild_id_header_out_of_range) {
+  fsb::arena arena;
+  ogg_packet op;
+  ASSERT_THROW(
+    rebuilder::rebuild_id_header(0, 8000, 256, 512, arena, op), fsb::error);
+  ASSERT_THROW(
+    rebuilder::rebuild_id_header(256, 8000, 256, 512, arena, op), fsb::error);
+  ASSERT_THROW(
+    rebuilder::rebuild_id_header(2, 0, 256, 512, arena, op), fsb::error);
 }
 
 TEST(rebuilder_test, rebuild_comment_header) {
-  ogg_packet_holder op;
+  fsb::arena arena;
+  ogg_packet op;
   
-  rebuilder::rebuild_comment_header(op, 0, 20);
+  rebuilder::rebuild_comment_header(0, 20, arena, op);
   
-  ASSERT_EQ(0, op->b_o_s);
-  ASSERT_EQ(0, op->e_o_s);
-  ASSERT_EQ(0, op->granulepos);
-  ASSERT_EQ(1, op->packetno);
+  ASSERT_EQ(0, op.b_o_s);
+  ASSERT_EQ(0, op.e_o_s);
+  ASSERT_EQ(0, op.granulepos);
+  ASSERT_EQ(1, op.packetno);
 }
 
 TEST(rebuilder_test, rebuild_setup_header) {
   const char header[] { 1, 2, 3, 4};
-  ogg_packet_holder op;
+  ogg_packet op;
   
   rebuilder::rebuild_setup_header(header, boost::size(header), op);
   
-  ASSERT_EQ(4, op->bytes);
-  ASSERT_EQ(1, op->packet[0]);
-  ASSERT_EQ(2, op->packet[1]);
-  ASSERT_EQ(3, op->packet[2]);
-  ASSERT_EQ(4, op->packet[3]);
-  ASSERT_EQ(0, op->b_o_s);
-  ASSERT_EQ(0, op->e_o_s);
-  ASSERT_EQ(0, op->granulepos);
-  ASSERT_EQ(2, op->packetno);
+  ASSERT_EQ(4, op.bytes);
+  ASSERT_EQ(1, op.packet[0]);
+  ASSERT_EQ(2, op.packet[1]);
+  ASSERT_EQ(3, op.packet[2]);
+  ASSERT_EQ(4, op.packet[3]);
+  ASSERT_EQ(0, op.b_o_s);
+  ASSERT_EQ(0, op.e_o_s);
+  ASSERT_EQ(0, op.granulepos);
+  ASSERT_EQ(2, op.packetno);
+}
+
+// Returns sample using Vorbis headers generated with given settings.
+fsb::sample make_sample(
+  const headers_generator & generator, int channels, int rate) {
+  fsb::sample sample;
+  sample.channels = channels;
+  sample.frequency = rate;
+  sample.vorbis_crc32 = crc32(generator.setup_header());
+  return sample;
+}
+
+TEST(rebuilder_test, rebuild_blocksize_table) {
+  headers_generator generator(2, 44100, 50);
+  vorbis_info * info = const_cast<vorbis_info*>(&generator.info());
+  
+  const blocksize_table blocksizes =
+    rebuilder::rebuild_blocksize_table(make_sample(generator, 2, 44100));
+  
+  // Encoder uses two modes, first with short and second with long blocks.
+  ASSERT_EQ(vorbis_info_blocksize(info, 0), blocksizes(0x00));
+  ASSERT_EQ(vorbis_info_blocksize(info, 1), blocksizes(0x02));
+  // Header packets are not audio packets.
+  ASSERT_EQ(0, blocksizes(0x01));
+  ASSERT_EQ(0, blocksizes(0x05));
+}
+
+TEST(rebuilder_test, duration) {
+  headers_generator generator(1, 22050, 10);
+  vorbis_info * info = const_cast<vorbis_info*>(&generator.info());
+  const long blocksize_short = vorbis_info_blocksize(info, 0);
+  const long blocksize_long = vorbis_info_blocksize(info, 1);
+  
+  const blocksize_table blocksizes =
+    rebuilder::rebuild_blocksize_table(make_sample(generator, 1, 22050));
+  
+  // Three audio packets (short, long, long) followed by alignment padding.
+  const char data[] {
+    1, 0, 0x00,
+    2, 0, 0x02, 0x7f,
+    1, 0, 0x02,
+    0, 0, 0, 0, 0, 0};
+  fsb::io::buffer_view view(data, boost::size(data));
+  
+  const std::uint64_t expected =
+    (blocksize_long + blocksize_short) / 4 +
+    (blocksize_long + blocksize_long) / 4;
+  ASSERT_EQ(expected, rebuilder::duration(blocksizes, view));
 }
 
 void assert_packets_eq(
@@ -167,6 +231,174 @@ TEST_P(generate_and_rebuild_test, headers_are_equivalent) {
   assert_packets_eq(generator.setup_header(), op_setup_header);
 }
 
+TEST(rebuilder_test, rebuild_comment_header_with_loop) {
+  vorbis_comment_holder comment;
+  comment.add_tag("LOOP_START", "10");
+  comment.add_tag("LOOP_END", "4294967295");
+  ogg_packet_holder expected;
+  vorbis_commentheader_out(comment, expected);
+  
+  fsb::arena arena;
+  ogg_packet op;
+  rebuilder::rebuild_comment_header(10, 4294967295u, arena, op);
+  assert_packets_eq(expected, op);
+}
+
+TEST(rebuilder_test, reused_rebuilder_matches_fresh_one) {
+  headers_generator generator_a(2, 44100, 50);
+  headers_generator generator_b(1, 22050, 10);
+  const fsb::sample sample_a = make_sample(generator_a, 2, 44100);
+  const fsb::sample sample_b = make_sample(generator_b, 1, 22050);
+  const std::vector<char> data_a = make_sample_data(300, 200);
+  const std::vector<char> data_b = make_sample_data(5, 20);
+  const fsb::io::buffer_view view_a(data_a.data(), data_a.size());
+  const fsb::io::buffer_view view_b(data_b.data(), data_b.size());
+  
+  rebuilder reused;
+  std::ostringstream reused_a, reused_b;
+  reused.rebuild(sample_a, view_a, reused_a);
+  reused.rebuild(sample_b, view_b, reused_b);
+  
+  std::ostringstream fresh_a, fresh_b;
+  rebuilder().rebuild(sample_a, view_a, fresh_a);
+  rebuilder().rebuild(sample_b, view_b, fresh_b);
+  
+  ASSERT_EQ(fresh_a.str(), reused_a.str());
+  ASSERT_EQ(fresh_b.str(), reused_b.str());
+}
+
+TEST(rebuilder_test, segments_can_be_rebuilt_independently) {
+  headers_generator generator(2, 44100, 50);
+  const fsb::sample sample = make_sample(generator, 2, 44100);
+  const std::vector<char> data = make_sample_data(300, 200);
+  const fsb::io::buffer_view view(data.data(), data.size());
+  const std::size_t segment_size = 4096;
+  
+  rebuilder rebuilder;
+  std::vector<rebuilder::checkpoint> segments(1);
+  std::ostringstream whole;
+  rebuilder.rebuild_segments(sample, view, segment_size, whole, segments);
+  ASSERT_LT(10u, segments.size());
+  
+  // Segments are rebuilt in reverse order, to make sure that none depends on
+  // state left by the previous one.
+  std::string rebuilt;
+  for (std::size_t i = segments.size(); i-- > 0;) {
+    std::ostringstream segment;
+    rebuilder.rebuild_segment(sample, view, segment_size, segments[i], segment);
+    ASSERT_EQ(segments[i].output_offset + segment.str().size(),
+      i + 1 < segments.size() ? 
+        segments[i + 1].output_offset : whole.str().size());
+    rebuilt.insert(0, segment.str());
+  }
+  ASSERT_EQ(whole.str(), rebuilt);
+}
+
+TEST(rebuilder_test, layout_matches_rebuilt_segments) {
+  headers_generator generator(2, 44100, 50);
+  const fsb::sample sample = make_sample(generator, 2, 44100);
+  
+  // Packets of sizes around lacing boundaries, and of various sizes, so that
+  // pages end after four packets, at 255 lacing values and across packets.
+  const int sizes[] = {1, 254, 255, 256, 510, 20, 3000, 70, 9000, 40};
+  std::vector<char> data;
+  for (int i = 0; i < 400; ++i) {
+    const int size = sizes[i % 10];
+    data.push_back(static_cast<char>(size));
+    data.push_back(static_cast<char>(size >> 8));
+    data.push_back(i % 8 ? 0x02 : 0x00);
+    data.insert(data.end(), size - 1, 0x55);
+  }
+  data.resize(data.size() + 32);
+  const fsb::io::buffer_view view(data.data(), data.size());
+  
+  rebuilder rebuilder;
+  for (const std::size_t segment_size : {std::size_t(1), std::size_t(4096), 
+       std::size_t(64 * 1024), std::size_t(1) << 40}) {
+    std::vector<rebuilder::checkpoint> expected(1);
+    std::ostringstream whole;
+    rebuilder.rebuild_segments(sample, view, segment_size, whole, expected);
+    
+    std::vector<rebuilder::checkpoint> actual(1);
+    ASSERT_EQ(whole.str().size(), 
+      rebuilder.layout_segments(sample, view, segment_size, actual));
+    ASSERT_EQ(expected.size(), actual.size());
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+      ASSERT_EQ(expected[i].output_offset, actual[i].output_offset);
+      ASSERT_EQ(expected[i].input_offset, actual[i].input_offset);
+      ASSERT_EQ(expected[i].page_number, actual[i].page_number);
+      ASSERT_EQ(expected[i].packet_number, actual[i].packet_number);
+      ASSERT_EQ(expected[i].granulepos, actual[i].granulepos);
+    }
+  }
+}
+
+TEST(rebuilder_test, channels_must_match_setup_header) {
+  // Stereo setup header couples two channels, it is invalid for mono.
+  headers_generator generator(2, 44100, 50);
+  const std::vector<char> data = make_sample_data(5, 20);
+  const fsb::io::buffer_view view(data.data(), data.size());
+  
+  rebuilder rebuilder;
+  std::ostringstream output;
+  rebuilder.rebuild(make_sample(generator, 2, 44100), view, output);
+  ASSERT_THROW(
+    rebuilder.rebuild(make_sample(generator, 1, 44100), view, output), 
+    fsb::error);
+}
+
+TEST(rebuilder_test, duration_channels_must_match_setup_header) {
+  headers_generator generator(2, 44100, 50);
+  const std::vector<char> data = make_sample_data(5, 20);
+  const fsb::io::buffer_view view(data.data(), data.size());
+  
+  rebuilder rebuilder;
+  ASSERT_LT(0u, rebuilder.duration(make_sample(generator, 2, 44100), view));
+  ASSERT_THROW(
+    rebuilder.duration(make_sample(generator, 1, 44100), view), fsb::error);
+}
+
+TEST(rebuilder_test, verification_does_not_change_output) {
+  headers_generator generator(2, 44100, 50);
+  const fsb::sample sample = make_sample(generator, 2, 44100);
+  const std::vector<char> data = make_sample_data(50, 100);
+  const fsb::io::buffer_view view(data.data(), data.size());
+  
+  std::ostringstream none, fast, full;
+  rebuilder(verification::none).rebuild(sample, view, none);
+  rebuilder(verification::fast).rebuild(sample, view, fast);
+  rebuilder(verification::full).rebuild(sample, view, full);
+  
+  ASSERT_EQ(none.str(), fast.str());
+  ASSERT_EQ(none.str(), full.str());
+}
+
+TEST(rebuilder_test, verify_data_after_last_packet) {
+  headers_generator generator(1, 22050, 10);
+  const fsb::sample sample = make_sample(generator, 1, 22050);
+  std::vector<char> data = make_sample_data(5, 20);
+  data[data.size() - 4] = 1;
+  const fsb::io::buffer_view view(data.data(), data.size());
+  
+  std::ostringstream output;
+  ASSERT_THROW(
+    rebuilder(verification::fast).rebuild(sample, view, output), fsb::error);
+}
+
+TEST(rebuilder_test, verify_loop_end) {
+  headers_generator generator(1, 22050, 10);
+  fsb::sample sample = make_sample(generator, 1, 22050);
+  sample.loop_start = 0;
+  sample.loop_end = 1000000;
+  const std::vector<char> data = make_sample_data(5, 20);
+  const fsb::io::buffer_view view(data.data(), data.size());
+  
+  std::ostringstream output;
+  ASSERT_NO_THROW(rebuilder().rebuild(sample, view, output));
+  ASSERT_THROW(
+    rebuilder(verification::fast).rebuild(sample, view, output), fsb::error);
+}
+
 INSTANTIATE_TEST_CASE_P(
     all_combinations,
     generate_and_rebuild_test,
@@ -0,0 +1,36 @@
+// Copyright (C) 2015 Tomasz Miąsko
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+#ifndef FSB_VORBIS_TEST_SUPPORT_HPP
+#define FSB_VORBIS_TEST_SUPPORT_HPP
+
+#include <vector>
+
+namespace fsb { namespace vorbis {
+
+// Returns Vorbis sample data with given number of packets of given size.
+inline std::vector<char> make_sample_data(int packets, int packet_size) {
+  std::vector<char> data;
+  for (int i = 0; i < packets; ++i) {
+    data.push_back(static_cast<char>(packet_size));
+    data.push_back(static_cast<char>(packet_size >> 8));
+    data.push_back(i % 8 ? 0x02 : 0x00);
+    data.insert(data.end(), packet_size - 1, 0x55);
+  }
+  // Alignment padding.
+  data.resize(data.size() + 32);
+  return data;
+}
+
+}}
+
+#endif
@@ -12,13 +12,17 @@
 //
 #include "fsb/vorbis/vorbis.hpp"
 
+#include "fsb/error.hpp"
+#include "fsb/stats.hpp"
+
 #include <boost/crc.hpp>
 #include <boost/utility/string_ref.hpp>
-#include <glog/logging.h>
 
 #include <algorithm>
 #include <cstdlib>
+#include <new>
 #include <ostream>
+#include <string>
 
 namespace fsb { namespace vorbis {
   
@@ -28,6 +32,15 @@ std::uint32_t crc32(ogg_packet const &packet) {
   return {result.checksum()};
 }
   
+void synthesis_headerin(
+  vorbis_info & info, vorbis_comment & comment, ogg_packet & packet) {
+  const int result = vorbis_synthesis_headerin(&info, &comment, &packet);
+  if (result != 0) {
+    throw error(
+      "vorbis_synthesis_headerin failed: " + std::to_string(result));
+  }
+}
+
 ogg_packet_holder::ogg_packet_holder()
 : value {} {
 }  
@@ -39,7 +52,9 @@ ogg_packet_holder::~ogg_packet_holder() {
 void ogg_packet_holder::assign(const unsigned char *buffer, std::size_t buffer_size) {
   unsigned char * const packet = 
     static_cast<unsigned char*>(std::malloc(buffer_size));
-  CHECK(packet || !buffer_size) << "Failed to allocate memory.";
+  if (!packet && buffer_size) {
+    throw std::bad_alloc();
+  }
   std::copy_n(buffer, buffer_size, packet);
   std::free(value.packet);
   value.packet = packet;
@@ -62,6 +77,19 @@ vorbis_info_holder::~vorbis_info_holder() {
   vorbis_info_clear(&value);
 }
 
+blocksize_table::blocksize_table(vorbis_info & info) {
+  // Packet type and mode number fit within a single byte, so it is enough to 
+  // ask libvorbis about all one byte packets.
+  for (int byte = 0; byte < 256; ++byte) {
+    unsigned char payload = byte;
+    ogg_packet packet {};
+    packet.packet = &payload;
+    packet.bytes = 1;
+    const long blocksize = vorbis_packet_blocksize(&info, &packet);
+    blocksizes_[byte] = blocksize > 0 ? blocksize : 0;
+  }
+}
+
 vorbis_comment_holder::vorbis_comment_holder() {
   vorbis_comment_init(&value);
 }
@@ -75,16 +103,28 @@ vorbis_comment_holder::~vorbis_comment_holder() {
 }
 
 ogg_ostream::ogg_ostream(int serial_number, std::ostream & output)
-: output_(output) {
-  CHECK(ogg_stream_init(&stream_state_, serial_number) == 0);
+: output_(&output) {
+  if (ogg_stream_init(&stream_state_, serial_number) != 0) {
+    throw std::bad_alloc();
+  }
+}
+
+ogg_ostream::ogg_ostream()
+: output_(nullptr) {
+  if (ogg_stream_init(&stream_state_, 0) != 0) {
+    throw std::bad_alloc();
+  }
 }
   
 ogg_ostream::~ogg_ostream() {
-  CHECK(ogg_stream_clear(&stream_state_) == 0);
+  ogg_stream_clear(&stream_state_);
 }
   
 void ogg_ostream::write_packet(ogg_packet & packet) {
-  CHECK(ogg_stream_packetin(&stream_state_, &packet) == 0);
+  // Stream state is cleared by libogg when it fails to grow its buffers.
+  if (ogg_stream_packetin(&stream_state_, &packet) != 0) {
+    throw std::bad_alloc();
+  }
     
   ogg_page page;
   while (ogg_stream_pageout(&stream_state_, &page)) {
@@ -99,9 +139,140 @@ void ogg_ostream::flush_packets() {
   }
 }
   
-void ogg_ostream::write_page(const ogg_page & page) {
-  CHECK(output_.write(reinterpret_cast<char*>(page.header), page.header_len));
-  CHECK(output_.write(reinterpret_cast<char*>(page.body), page.body_len));
+void ogg_ostream::reset(int serial_number, std::ostream & output) {
+  if (ogg_stream_reset_serialno(&stream_state_, serial_number) != 0) {
+    throw error("ogg_stream_reset_serialno failed.");
+  }
+  output_ = &output;
+  bytes_written_ = 0;
+  page_number_offset_ = 0;
+}
+
+void ogg_ostream::resume(
+  int serial_number, std::ostream & output, long page_number) {
+  reset(serial_number, output);
+  // Stream can only be started from the first page, so it is begun with a 
+  // page holding an empty packet, which is dropped. Following pages are 
+  // laid out as in the middle of a stream, and are renumbered when written.
+  unsigned char payload = 0;
+  ogg_packet packet {};
+  packet.packet = &payload;
+  packet.bytes = 0;
+  packet.b_o_s = 1;
+  if (ogg_stream_packetin(&stream_state_, &packet) != 0) {
+    throw std::bad_alloc();
+  }
+  ogg_page page;
+  while (ogg_stream_flush(&stream_state_, &page)) {
+  }
+  page_number_offset_ = page_number - stream_state_.pageno;
+}
+
+void ogg_ostream::write_page(ogg_page & page) {
+  if (page_number_offset_) {
+    // Page sequence number is stored in bytes 18 to 21, least significant
+    // byte first.
+    const long number = ogg_page_pageno(&page) + page_number_offset_;
+    for (int i = 0; i != 4; ++i) {
+      page.header[18 + i] = static_cast<unsigned char>(number >> (8 * i));
+    }
+    ogg_page_checksum_set(&page);
+  }
+  
+  stats::scoped_timer timer(stats::stage::write);
+  stats::add(stats::counter::pages);
+  stats::add(stats::counter::bytes_written, page.header_len + page.body_len);
+  if (!output_) {
+    throw error("Ogg stream without output.");
+  }
+  output_->write(reinterpret_cast<char*>(page.header), page.header_len);
+  output_->write(reinterpret_cast<char*>(page.body), page.body_len);
+  bytes_written_ += page.header_len + page.body_len;
+  if (!*output_) {
+    throw error("Failed to write Ogg page.");
+  }
+}
+
+void ogg_layout::write_packet(const ogg_packet & packet) {
+  // Packet is laced into 255 byte segments followed by a shorter one.
+  for (long remaining = packet.bytes; ; remaining -= 255) {
+    if (remaining < 255) {
+      lacing_values_.push_back(static_cast<unsigned char>(remaining));
+      break;
+    }
+    lacing_values_.push_back(255);
+  }
+  ended_ = packet.e_o_s != 0;
+  
+  // As ogg_stream_pageout, which forces out the first page and pages at the
+  // end of stream.
+  while (page_out(!lacing_values_.empty() && (ended_ || !begun_))) {
+  }
+}
+
+void ogg_layout::flush_packets() {
+  while (page_out(true)) {
+  }
+}
+
+void ogg_layout::reset() {
+  lacing_values_.clear();
+  begun_ = false;
+  ended_ = false;
+  page_number_ = 0;
+  bytes_written_ = 0;
+}
+
+bool ogg_layout::page_out(bool force) {
+  // Same choice of segments as in ogg_stream_flush_i of libogg, with pages
+  // filled up to 4096 bytes.
+  const std::size_t max_values = 
+    std::min<std::size_t>(lacing_values_.size(), 255);
+  if (max_values == 0) {
+    return false;
+  }
+  
+  std::size_t values = 0;
+  std::uint64_t body_size = 0;
+  if (!begun_) {
+    // The first page holds only the first packet.
+    while (values < max_values) {
+      body_size += lacing_values_[values];
+      if (lacing_values_[values++] < 255) {
+        break;
+      }
+    }
+  } else {
+    // Page is not ended before four packets are done on it, unless it is
+    // forced out.
+    int packets_done = 0;
+    int packet_just_done = 0;
+    for (; values < max_values; ++values) {
+      if (body_size > 4096 && packet_just_done >= 4) {
+        force = true;
+        break;
+      }
+      body_size += lacing_values_[values];
+      if (lacing_values_[values] < 255) {
+        packet_just_done = ++packets_done;
+      } else {
+        packet_just_done = 0;
+      }
+    }
+    if (values == 255) {
+      force = true;
+    }
+  }
+  if (!force) {
+    return false;
+  }
+  
+  // Header has 27 bytes followed by lacing values.
+  bytes_written_ += 27 + values + body_size;
+  lacing_values_.erase(lacing_values_.begin(), lacing_values_.begin() + values);
+  begun_ = true;
+  page_number_ += 1;
+  return true;
 }
 
 }}
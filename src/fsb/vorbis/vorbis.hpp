@@ -20,12 +20,18 @@
 
 #include <cstdint>
 #include <iosfwd>
+#include <vector>
 
 namespace fsb { namespace vorbis {
 
 // Returns CRC-32 of Vorbis packet payload.
 std::uint32_t crc32(ogg_packet const &packet);
 
+// Decodes header packet with vorbis_synthesis_headerin. Throws error if
+// header is invalid.
+void synthesis_headerin(
+  vorbis_info & info, vorbis_comment & comment, ogg_packet & packet);
+
 // RAII holder for ogg_packet.
 class ogg_packet_holder {
   ogg_packet_holder(const ogg_packet_holder &) = delete;
@@ -68,6 +74,10 @@ public:
   // to given output stream.
   ogg_ostream(int serial_number, std::ostream & output);
   
+  // Constructs Ogg stream without output, reset must be called before any 
+  // packets are written.
+  ogg_ostream();
+  
   // Destroys Ogg stream.
   ~ogg_ostream();
   
@@ -79,13 +89,71 @@ public:
   // Note: It does not flush output stream.
   void flush_packets();
   
+  // Starts a new logical stream with given serial number, that will write its
+  // output to given output stream. Buffers of previous stream are reused.
+  void reset(int serial_number, std::ostream & output);
+  
+  // Continues a logical stream, that was flushed with flush_packets, from a 
+  // page with given number. Its output is written to given output stream.
+  void resume(int serial_number, std::ostream & output, long page_number);
+  
+  // Returns number of the next page.
+  long page_number() const {
+    return stream_state_.pageno + page_number_offset_;
+  }
+  
+  // Returns number of bytes written since the stream was started or resumed.
+  std::uint64_t bytes_written() const {
+    return bytes_written_;
+  }
+  
 private:
-  // Writes page header and page body to output stream.
-  void write_page(const ogg_page & page);
+  // Writes page header and page body to output stream. Pages of resumed 
+  // stream are renumbered first.
+  void write_page(ogg_page & page);
   
 private:
-  std::ostream & output_;
+  std::ostream * output_;
   ogg_stream_state stream_state_;
+  std::uint64_t bytes_written_ = 0;
+  // Added to numbers of pages written by resumed stream.
+  long page_number_offset_ = 0;
+};
+
+// Computes sizes of pages that ogg_ostream writes for the same packets, 
+// without copying packets into pages or computing their checksums. Pages 
+// are laid out as libogg lays them out.
+class ogg_layout {
+public:
+  // Submits packet, only its size and end of stream flag are used.
+  void write_packet(const ogg_packet & packet);
+  
+  // Forces remaining packets into pages.
+  void flush_packets();
+  
+  // Starts a new logical stream.
+  void reset();
+  
+  long page_number() const {
+    return page_number_;
+  }
+  
+  // Returns number of bytes of pages since the stream was started.
+  std::uint64_t bytes_written() const {
+    return bytes_written_;
+  }
+  
+private:
+  // Takes the next page out of the stream, returns false if there is none.
+  bool page_out(bool force);
+  
+private:
+  // Lacing values of packets not yet in pages.
+  std::vector<unsigned char> lacing_values_;
+  bool begun_ = false;
+  bool ended_ = false;
+  long page_number_ = 0;
+  std::uint64_t bytes_written_ = 0;
 };
 
 // RAII holder for vorbis_info.
@@ -111,6 +179,25 @@ private:
   vorbis_info value;
 };
 
+// Maps the first byte of Vorbis audio packet to its block size.
+//
+// The first byte of an audio packet contains packet type and mode number, 
+// which together determine the block size without decoding the rest of the
+// packet.
+class blocksize_table {
+public:
+  // Constructs table from vorbis_info initialized with all three headers.
+  explicit blocksize_table(vorbis_info & info);
+  
+  // Returns block size of an audio packet starting with given byte, or zero if
+  // byte does not start a valid audio packet.
+  long operator()(unsigned char first_byte) const {
+    return blocksizes_[first_byte];
+  }
+private:
+  long blocksizes_[256];
+};
+
 // RAII holder for vorbis_comment.
 class vorbis_comment_holder {
   vorbis_comment_holder(const vorbis_comment_holder &) = delete;